@@ -0,0 +1,58 @@
+/**
+ * Host check of the display number conversion (src/dec.h) against
+ * sprintf: every 16-bit value at every width up to 5, every signed value, and
+ * lines built by chaining the helpers:
+ *
+ *   gcc -I../src -o dectest dectest.c ../src/dec.c
+ *   ./dectest
+ *
+ * Cycle counts per conversion need the AVR build under a simulator such
+ * as simavr; host timings say nothing about the ATmega32.
+ */
+
+#include <stdio.h>
+#include <string.h>
+#include "dec.h"
+
+static unsigned long bad;
+
+static void
+expect(const char *got, const char *want)
+{
+	if (strcmp(got, want)) {
+		if (bad < 10) printf("got \"%s\", want \"%s\"\n", got, want);
+		++bad;
+	}
+}
+
+int
+main(void)
+{
+	char a[24], b[24];
+	long v;
+	int w;
+	
+	for (v = 0; v <= 0xffff; ++v) {
+		for (w = 0; w <= 5; ++w) {
+			put_dec(a, v, w);
+			sprintf(b, "%0*lu", w, v);
+			expect(a, b);
+		}
+	}
+	for (v = -32768; v <= 32767; ++v) {
+		put_sdec(a, v, 1);
+		sprintf(b, "%ld", v);
+		expect(a, b);
+	}
+	put_sdec(a, -32768, 1);
+	expect(a, "-32768");
+	put_sdec(a, -5, 3);
+	expect(a, "-005");
+	
+	// Return value: the end of the string, so lines can be chained
+	put_str(put_dec(put_str(a, "Load: "), 42, 1), " kW");
+	expect(a, "Load: 42 kW");
+	
+	printf("%s, %lu mismatches\n", bad ? "WRONG" : "ok", bad);
+	return bad != 0;
+}
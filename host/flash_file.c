@@ -0,0 +1,78 @@
+/**
+ * File-backed stand-in for the SPI flash driver (src/flash.c), so the log
+ * code can run on a PC. The image is taken from $OBD_FLASH (default
+ * flash.bin) and created erased if it does not exist. Programming only
+ * clears bits, as on a real NOR flash.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "flash.h"
+
+static FILE *img;
+
+void
+ini_flash(void)
+{
+	const char *path = getenv("OBD_FLASH");
+	unsigned long i;
+	if (!path) path = "flash.bin";
+	img = fopen(path, "r+b");
+	if (!img) {
+		img = fopen(path, "w+b");
+		if (!img) {
+			perror(path);
+			exit(1);
+		}
+		for (i = 0; i < FLASH_SIZE; ++i) {
+			fputc(0xff, img);
+		}
+	}
+}
+
+unsigned char
+busy_flash(void)
+{
+	return 0;
+}
+
+void
+rd_flash(unsigned long a, void *buf, unsigned short n)
+{
+	memset(buf, 0xff, n);
+	fseek(img, a, SEEK_SET);
+	if (fread(buf, 1, n, img) != n) {
+		fprintf(stderr, "short read at %06lx\n", a);
+	}
+}
+
+void
+wr_flash(unsigned long a, const void *buf, unsigned short n)
+{
+	const unsigned char *p = buf;
+	unsigned char old[FLASH_PAGE];
+	unsigned short i;
+	if (a / FLASH_PAGE != (a + n - 1) / FLASH_PAGE) {
+		fprintf(stderr, "program crosses a page at %06lx\n", a);
+		return;
+	}
+	rd_flash(a, old, n);
+	for (i = 0; i < n; ++i) {
+		old[i] &= p[i];
+	}
+	fseek(img, a, SEEK_SET);
+	fwrite(old, 1, n, img);
+	fflush(img);
+}
+
+void
+er_flash(unsigned long a)
+{
+	unsigned short i;
+	fseek(img, a & ~(FLASH_SECTOR - 1lu), SEEK_SET);
+	for (i = 0; i < FLASH_SECTOR; ++i) {
+		fputc(0xff, img);
+	}
+	fflush(img);
+}
@@ -0,0 +1,56 @@
+/**
+ * Prints the contents of a data log read through the flash driver, which
+ * on a PC is the file-backed stand-in:
+ *
+ *   gcc -I../src -o logdump logdump.c flash_file.c ../src/crc.c
+ *   OBD_FLASH=image.bin ./logdump
+ *
+ * Blocks failing their CRC are reported and skipped; decoding resumes at
+ * the next sync header.
+ */
+
+#include <stdio.h>
+#include "crc.h"
+#include "flash.h"
+#include "log.h"
+
+#include "../src/log.c"
+
+int
+main(void)
+{
+	unsigned char b[LOG_BLOCK], pids[LOG_BLOCK];
+	unsigned char i, n = 0, len;
+	unsigned long a, t, ms;
+	unsigned short dt, v;
+	
+	ini_flash();
+	for (a = 0; a < FLASH_SIZE; a += LOG_BLOCK) {
+		rd_flash(a, b, LOG_BLOCK);
+		if (b[0] == 0xff) break;
+		if (!check_log(b)) {
+			printf("%06lx: bad block\n", a);
+			continue;
+		}
+		t = b[4] | (b[5] << 8) | ((unsigned long)b[6] << 16) | ((unsigned long)b[7] << 24);
+		if (b[1] == LOG_HDR) {
+			printf("%06lx: session, VIN %.17s, PIDs", a, b + LOG_HEAD);
+			len = b[LOG_HEAD + LOG_VIN];
+			for (i = 0; i < len; ++i) {
+				pids[i] = b[LOG_HEAD + LOG_VIN + 1 + i];
+				printf(" %02X", pids[i]);
+			}
+			n = len;
+			printf("\n");
+			continue;
+		}
+		for (i = LOG_HEAD; i + LOG_REC < LOG_BLOCK && b[i] != 0xff; i += LOG_REC) {
+			dt = b[i + 1] | (b[i + 2] << 8);
+			v = b[i + 3] | (b[i + 4] << 8);
+			t += dt;
+			ms = (t << LOG_TSHIFT) / 125; // Timer1 runs at 125 kHz
+			printf("%10lu ms  PID %02X  %u\n", ms, b[i] < n ? pids[b[i]] : 0xff, v);
+		}
+	}
+	return 0;
+}
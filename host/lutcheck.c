@@ -0,0 +1,65 @@
+/**
+ * Host check of the PID lookup tables (src/pids.h): every PID_TABLE entry
+ * of the PID list is built as the firmware builds it and compared with
+ * its scaling for all 256 raw values:
+ *
+ *   gcc -I../src -o lutcheck lutcheck.c
+ *   ./lutcheck
+ *
+ * Cycle counts need the AVR build under a simulator such as simavr; on
+ * the host the arithmetic and the table read are both a few instructions
+ * and timing them says nothing about the ATmega32.
+ */
+
+#include <stdio.h>
+#include "snap.h"
+#include "filt.h"
+#include "fuel.h"
+
+#define PROGMEM
+#define pgm_read_byte(p) (*(p))
+#include "pids.h"
+
+#define TABLE_PID(p, id, field, len, min, max, filt, fuel, how, scale) how##_DEF(p, scale)
+PID_LIST(TABLE_PID)
+#undef TABLE_PID
+
+static int tables;
+
+static int
+check(unsigned char pid, const unsigned char *table, int (*calc)(int))
+{
+	int r, bad = 0;
+	
+	for (r = 0; r < 256; ++r) {
+		if (table[r] != (unsigned char)calc(r)) {
+			printf("PID %02X: raw %d gives %d, should be %d\n", pid, r, table[r], calc(r));
+			++bad;
+		}
+	}
+	printf("PID %02X: %s\n", pid, bad ? "WRONG" : "ok");
+	++tables;
+	return bad;
+}
+
+// One scaling function and check per table entry
+#define PID_CALC_CHECK(p, scale)
+#define PID_TABLE_CHECK(p, scale) static int calc_##p(int r) { return scale(r); }
+#define CALC_PID(p, id, field, len, min, max, filt, fuel, how, scale) how##_CHECK(p, scale)
+PID_LIST(CALC_PID)
+#undef CALC_PID
+
+#define PID_CALC_RUN(p)
+#define PID_TABLE_RUN(p) bad += check(p, pid_table_##p, calc_##p);
+
+int
+main(void)
+{
+	int bad = 0;
+	
+#define RUN_PID(p, id, field, len, min, max, filt, fuel, how, scale) how##_RUN(p)
+	PID_LIST(RUN_PID)
+#undef RUN_PID
+	printf("%d tables checked\n", tables);
+	return bad != 0;
+}
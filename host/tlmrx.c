@@ -0,0 +1,121 @@
+/**
+ * Host receiver for the telemetry stream (src/tlm.h). Reads frames from a
+ * serial device, or from a pty when testing without hardware:
+ *
+ *   gcc -I../src -o tlmrx tlmrx.c ../src/crc.c
+ *   ./tlmrx /dev/ttyUSB0
+ *
+ *   socat pty,raw,echo=0,link=/tmp/obd pty,raw,echo=0,link=/tmp/host &
+ *   ./tlmrx /tmp/host   # and write frames to /tmp/obd
+ *
+ * Each sample is printed as: time in ms, PID, value. Histogram frames are
+ * printed one RPM bin per line, with the count for each load bin.
+ */
+
+#include <stdio.h>
+#include <fcntl.h>
+#include <termios.h>
+#include <unistd.h>
+#include "crc.h"
+#include "tlm.h"
+#include "hist.h"
+
+static unsigned char pids[256];
+static unsigned char npids;
+static unsigned short next_seq;
+static unsigned long lost;
+
+static void
+frame(const unsigned char *f, unsigned short n)
+{
+	unsigned short crc = 0xffff, seq, i, j;
+	unsigned long base, t;
+	
+	if (n < 5) return;
+	for (i = 0; i < n - 2; ++i) {
+		crc = crc16(crc, f[i]);
+	}
+	if (crc != ((f[n - 2] << 8) | f[n - 1])) {
+		fprintf(stderr, "bad CRC\n");
+		return;
+	}
+	seq = f[1] | (f[2] << 8);
+	if (seq != next_seq) {
+		lost += (unsigned short)(seq - next_seq);
+		fprintf(stderr, "lost %lu frames so far\n", lost);
+	}
+	next_seq = seq + 1;
+	f += 3;
+	n -= 5;
+	
+	switch (f[-3]) {
+	case TLM_MAP:
+		for (i = 0; i < n; ++i) {
+			pids[i] = f[i];
+		}
+		npids = n;
+		break;
+	case TLM_SAMPLES:
+		base = f[0] | (f[1] << 8) | ((unsigned long)f[2] << 16) | ((unsigned long)f[3] << 24);
+		for (i = 4; i + TLM_REC <= n; i += TLM_REC) {
+			t = base + (f[i + 1] | (f[i + 2] << 8));
+			printf("%10lu ms  PID %02X  %u\n", (t << TLM_TSHIFT) / 125,
+					f[i] < npids ? pids[f[i]] : 0xff, f[i + 3] | (f[i + 4] << 8));
+		}
+		fflush(stdout);
+		break;
+	case TLM_HIST:
+		// One line per RPM bin, one count per load bin
+		for (i = 2; i + 2 * HIST_LOAD <= n; i += 2 * HIST_LOAD) {
+			printf("%s %u-%u RPM:", f[0] ? "life" : "trip", (f[1] + (i - 2) / (2 * HIST_LOAD)) * 1000,
+					(f[1] + (i - 2) / (2 * HIST_LOAD) + 1) * 1000 - 1);
+			for (j = 0; j < HIST_LOAD; ++j) {
+				printf(" %5u", f[i + 2 * j] | (f[i + 2 * j + 1] << 8));
+			}
+			printf("\n");
+		}
+		fflush(stdout);
+		break;
+	}
+}
+
+int
+main(int argc, char **argv)
+{
+	unsigned char in[512], out[512], c;
+	unsigned short n = 0, i, j, o;
+	struct termios tio;
+	int fd = 0;
+	
+	if (argc > 1) {
+		fd = open(argv[1], O_RDONLY | O_NOCTTY);
+		if (fd < 0) {
+			perror(argv[1]);
+			return 1;
+		}
+	}
+	if (tcgetattr(fd, &tio) == 0) {
+		cfmakeraw(&tio);
+		cfsetispeed(&tio, B9600);
+		tcsetattr(fd, TCSANOW, &tio);
+	}
+	
+	while (read(fd, &c, 1) == 1) {
+		if (c) {
+			if (n < sizeof(in)) in[n++] = c;
+			continue;
+		}
+		
+		// COBS decode the bytes before the delimiter
+		for (i = 0, o = 0; i < n; ) {
+			unsigned char code = in[i++];
+			for (j = 1; j < code && i < n; ++j) {
+				out[o++] = in[i++];
+			}
+			if (code < 0xff && i < n) out[o++] = 0;
+		}
+		frame(out, o);
+		n = 0;
+	}
+	return 0;
+}
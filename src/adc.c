@@ -0,0 +1,123 @@
+#include <util/atomic.h>
+#include "avr.h"
+#include "snap.h"
+#include "adc.h"
+
+// Each conversion takes 13 ADC clocks at 125 kHz, about 9.6k samples per
+// second shared by the channels. The interrupt adds the result to its
+// channel's sum, selects the next channel and starts the next conversion.
+// After ADC_AVG rounds all sums are latched for get_adc(), which also
+// averages ADC_REC readings into a slower one to be recorded. The lowest
+// battery sample is kept as well, which catches the cranking dip between
+// OBD polls.
+
+static const struct adc_ch adc_chs[ADC_CHS] PROGMEM = {
+	{ 0, VAL_BATT, { 0, 1781, 3562, 5344, 7125, 8906, 10688, 12469, 14250,
+			16031, 17812, 19594, 21375, 23156, 24938, 26719, 28500 } },
+	{ 1, VAL_OIL, { 0, 0, 31, 109, 188, 266, 344, 422, 500,
+			578, 656, 734, 812, 891, 969, 1047, 1125 } },
+	{ 2, VAL_EGT, { 0, 62, 125, 188, 250, 312, 375, 438, 500,
+			562, 625, 688, 750, 812, 875, 938, 1000 } },
+	{ 3, VAL_BOOST, { 0, 7, 29, 51, 72, 94, 116, 138, 160,
+			182, 204, 226, 248, 269, 291, 313, 335 } },
+};
+
+static unsigned long adc_sum[ADC_CHS];
+static volatile unsigned long adc_done[ADC_CHS];
+static volatile unsigned char adc_ready; // One bit per channel
+static unsigned char adc_cur;
+static unsigned short adc_rounds;
+static unsigned long adc_acc[ADC_CHS];
+static unsigned char adc_n[ADC_CHS];
+static volatile unsigned short adc_min = 0xffff;
+static unsigned char cranking;
+
+static unsigned short
+cal_adc(unsigned char ch, unsigned short x)
+{
+	// x is the raw reading * 16
+	const unsigned short *cal = adc_chs[ch].cal;
+	unsigned char i = x >> 10;
+	unsigned short y0 = pgm_read_word(&cal[i]);
+	if (i == 16) return y0;
+	return y0 + (((long)pgm_read_word(&cal[i + 1]) - y0) * (x & 1023) >> 10);
+}
+
+void
+ini_adc(void)
+{
+	DDRA &= ~((1 << ADC_CHS) - 1);
+	ADMUX = (1 << REFS0) | pgm_read_byte(&adc_chs[0].mux); // AVCC reference
+	ADCSRA = (1 << ADEN) | (1 << ADSC) | (1 << ADIE) | (1 << ADPS2) | (1 << ADPS1); // Prescaler 64
+}
+
+ISR(ADC_vect)
+{
+	unsigned short v = ADCW;
+	unsigned char c = adc_cur;
+	
+	adc_sum[c] += v;
+	if (c == BATT_CH && v < adc_min) adc_min = v;
+	if (++c == ADC_CHS) {
+		c = 0;
+		if (++adc_rounds == ADC_AVG) {
+			adc_rounds = 0;
+			for (v = 0; v < ADC_CHS; ++v) {
+				adc_done[v] = adc_sum[v];
+				adc_sum[v] = 0;
+			}
+			adc_ready = (1 << ADC_CHS) - 1;
+		}
+	}
+	adc_cur = c;
+	ADMUX = (1 << REFS0) | pgm_read_byte(&adc_chs[c].mux);
+	SET_BIT(ADCSRA, ADSC);
+}
+
+unsigned char
+get_adc(unsigned char *id, unsigned short *v, unsigned char *rec)
+{
+	unsigned long s;
+	unsigned char c;
+	
+	if (!adc_ready) return 0;
+	for (c = 0; !(adc_ready & (1 << c)); ++c);
+	ATOMIC_BLOCK(ATOMIC_RESTORESTATE) {
+		s = adc_done[c];
+		adc_ready &= ~(1 << c);
+	}
+	*id = pgm_read_byte(&adc_chs[c].id);
+	adc_acc[c] += s;
+	*rec = ++adc_n[c] == ADC_REC;
+	if (*rec) { // Every ADC_REC-th reading is their average
+		s = adc_acc[c] / ADC_REC;
+		adc_acc[c] = 0;
+		adc_n[c] = 0;
+	}
+	*v = cal_adc(c, s / (ADC_AVG / 16));
+	return 1;
+}
+
+unsigned char
+crank_adc(unsigned short rpm, unsigned short *mv)
+{
+	unsigned short m;
+	
+	// The minimum is reset on every sample with the engine stopped, and
+	// read once RPM shows the engine has started
+	if (rpm == 0) {
+		ATOMIC_BLOCK(ATOMIC_RESTORESTATE) {
+			adc_min = 0xffff;
+		}
+		cranking = 1;
+	}
+	else if (cranking && rpm > CRANK_RPM) {
+		cranking = 0;
+		ATOMIC_BLOCK(ATOMIC_RESTORESTATE) {
+			m = adc_min;
+		}
+		*mv = cal_adc(BATT_CH, m << 4);
+		return 1;
+	}
+	return 0;
+}
@@ -0,0 +1,28 @@
+#ifndef __adc__
+#define __adc__
+
+// Analog inputs on PORTA, converted in turn by the ADC interrupt:
+//   PA0  12V from OBD pin 16 through a 47k/10k divider, in mV
+//   PA1  Oil pressure sender, 0.5-4.5 V ratiometric, in kPa
+//   PA2  EGT thermocouple amplifier (AD8495, 5 mV/C), in C
+//   PA3  Boost pressure sensor, 0.5-4.5 V for 20-300 kPa, in kPa
+// Each channel has a 17-point calibration table giving its value at raw
+// readings 0, 64, ..., 1024; readings in between are interpolated.
+
+#define ADC_CHS 4
+#define ADC_AVG 64 // Samples averaged per reading, about 27 ms, for the display and alarms
+#define ADC_REC 16 // Readings averaged per recorded one, about 0.43 s, for the ring and log
+#define BATT_CH 0 // Channel whose minimum is tracked for the cranking dip
+#define CRANK_RPM 500 // RPM above which the engine has started
+
+struct adc_ch {
+	unsigned char mux; // ADC input
+	unsigned char id; // Value id
+	unsigned short cal[17];
+};
+
+void ini_adc(void);
+unsigned char get_adc(unsigned char *id, unsigned short *v, unsigned char *rec);
+unsigned char crank_adc(unsigned short rpm, unsigned short *mv);
+
+#endif
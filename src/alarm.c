@@ -0,0 +1,91 @@
+#include <string.h>
+#include "avr.h"
+#include "snap.h"
+#include "alarm.h"
+
+// run_alarm() is called for every decoded sample, so it only walks the
+// table and compares. An alarm that triggers sets alarm_new, which makes
+// the main loop redraw the display at once instead of at the next tick.
+
+static const char msg_temp[] PROGMEM = "Coolant hot!";
+static const char msg_rpm[] PROGMEM = "Over-rev!";
+static const char msg_mil[] PROGMEM = "Check engine!";
+static const char msg_batt[] PROGMEM = "Battery low!";
+
+static const struct alarm alarms[] PROGMEM = {
+	{ VAL_TEMP, ALARM_BUZZ, 110, 105, 3, msg_temp },
+	{ VAL_RPM, ALARM_BUZZ, 6500, 6200, 2, msg_rpm },
+	{ VAL_MIL, 0, 1, 0, 1, msg_mil },
+	{ VAL_BATT, ALARM_BELOW, 11500, 12000, 10, msg_batt },
+};
+
+#define NUM_ALARMS (sizeof(alarms) / sizeof(alarms[0]))
+
+static unsigned char count[NUM_ALARMS]; // Consecutive samples beyond the trigger
+static unsigned char active; // One bit per alarm
+static unsigned char acked; // Active alarms the user has dismissed
+static signed short last[NUM_ALARMS];
+unsigned char alarm_new;
+
+void
+ini_alarm(void)
+{
+	CLR_BIT(PORTA, BUZZ_PIN);
+	SET_BIT(DDRA, BUZZ_PIN);
+}
+
+void
+run_alarm(unsigned char id, unsigned short v)
+{
+	struct alarm a;
+	unsigned char i, bit, buzz = 0;
+	signed short s = v;
+	
+	for (i = 0, bit = 1; i < NUM_ALARMS; ++i, bit <<= 1) {
+		if (pgm_read_byte(&alarms[i].id) != id) continue;
+		memcpy_P(&a, &alarms[i], sizeof(a));
+		last[i] = s;
+		if (a.flags & ALARM_BELOW ? s <= a.on : s >= a.on) {
+			if (count[i] < a.debounce) ++count[i];
+			if (count[i] == a.debounce && !(active & bit)) {
+				active |= bit;
+				alarm_new = 1;
+			}
+		}
+		else {
+			count[i] = 0;
+			if (a.flags & ALARM_BELOW ? s >= a.off : s <= a.off) {
+				active &= ~bit;
+				acked &= ~bit;
+			}
+		}
+	}
+	
+	for (i = 0, bit = 1; i < NUM_ALARMS; ++i, bit <<= 1) {
+		if ((active & ~acked & bit) && (pgm_read_byte(&alarms[i].flags) & ALARM_BUZZ)) buzz = 1;
+	}
+	if (buzz) SET_BIT(PORTA, BUZZ_PIN); else CLR_BIT(PORTA, BUZZ_PIN);
+}
+
+unsigned char
+get_alarm(const char **msg, signed short *v)
+{
+	unsigned char i, bit;
+	
+	// The first alarm in the table has the highest priority
+	for (i = 0, bit = 1; i < NUM_ALARMS; ++i, bit <<= 1) {
+		if (active & ~acked & bit) {
+			*msg = (const char *)pgm_read_word(&alarms[i].msg);
+			*v = last[i];
+			return 1;
+		}
+	}
+	return 0;
+}
+
+void
+ack_alarm(void)
+{
+	acked = active;
+	CLR_BIT(PORTA, BUZZ_PIN);
+}
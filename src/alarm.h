@@ -0,0 +1,24 @@
+#ifndef __alarm__
+#define __alarm__
+
+#define ALARM_BELOW 1 // Trigger on low values instead of high ones
+#define ALARM_BUZZ 2 // Sound the buzzer while active
+#define BUZZ_PIN 7 // PA7
+
+struct alarm {
+	unsigned char id; // Value id
+	unsigned char flags;
+	signed short on; // Trigger at or beyond this value
+	signed short off; // Clear at or within this value
+	unsigned char debounce; // Consecutive samples needed to trigger
+	const char *msg; // In program memory
+};
+
+extern unsigned char alarm_new;
+
+void ini_alarm(void);
+void run_alarm(unsigned char id, unsigned short v);
+unsigned char get_alarm(const char **msg, signed short *v);
+void ack_alarm(void);
+
+#endif
@@ -0,0 +1,82 @@
+#include "avr.h"
+#include "align.h"
+
+// The PIDs are polled one at a time, so no two values are sampled at the
+// same moment. Values that are combined are first brought onto a common
+// grid: at each grid time every value is interpolated between its samples
+// on either side. A grid point is ready once every value has a sample at
+// or after it, so results lag the bus by about one polling round.
+
+struct align_s {
+	unsigned long t;
+	unsigned short v;
+};
+
+static struct align_s align_h[ALIGN_CH][ALIGN_HIST]; // Newest sample first
+static unsigned char align_n[ALIGN_CH]; // Samples held
+static unsigned char align_ch; // Channels in use
+static unsigned long align_g; // Next grid time
+static unsigned char align_on; // align_g is set
+
+void
+ini_align(unsigned char n)
+{
+	align_ch = n;
+}
+
+void
+put_align(unsigned char ch, unsigned long t, unsigned short v)
+{
+	struct align_s *h = align_h[ch];
+	unsigned char i;
+	
+	for (i = ALIGN_HIST - 1; i; --i) {
+		h[i] = h[i - 1];
+	}
+	h[0].t = t;
+	h[0].v = v;
+	if (align_n[ch] < ALIGN_HIST) ++align_n[ch];
+	if (!align_on) {
+		align_g = t;
+		align_on = 1;
+	}
+}
+
+static unsigned char
+at_align(unsigned char ch, unsigned long g, unsigned short *v)
+{
+	// 0: g is past the newest sample, 1: done, 2: no samples around g
+	struct align_s *h = align_h[ch];
+	unsigned char i;
+	unsigned long dt;
+	
+	if (!align_n[ch] || (long)(g - h[0].t) > 0) return 0;
+	for (i = 1; i < align_n[ch] && (long)(g - h[i].t) < 0; ++i);
+	if (i == align_n[ch]) return 2;
+	dt = h[i - 1].t - h[i].t;
+	if (dt > ALIGN_GAP) return 2;
+	// Times in units of 16 ticks keep the product in 32 bits:
+	// 65535 * (ALIGN_GAP >> 4) is below 2^31
+	dt >>= 4;
+	if (!dt) *v = h[i - 1].v;
+	else *v = h[i].v + ((long)h[i - 1].v - h[i].v) * (long)((g - h[i].t) >> 4) / (long)dt;
+	return 1;
+}
+
+unsigned char
+next_align(unsigned long *t, unsigned short *v)
+{
+	unsigned char ch, r;
+	
+	if (!align_on) return 0;
+	for (;;) {
+		r = 1;
+		for (ch = 0; ch < align_ch && r == 1; ++ch) {
+			r = at_align(ch, align_g, &v[ch]);
+		}
+		if (r == 0) return 0;
+		*t = align_g;
+		align_g += ALIGN_STEP;
+		if (r == 1) return 1;
+	}
+}
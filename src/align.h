@@ -0,0 +1,18 @@
+#ifndef __align__
+#define __align__
+
+#define ALIGN_CH 3 // Values resampled together
+#define ALIGN_HIST 4 // Samples kept per value
+#define ALIGN_STEP (TICK_HZ / 4) // Grid spacing, 250 ms
+#define ALIGN_GAP (2 * TICK_HZ) // Samples further apart are not interpolated
+
+// Channels
+#define ALIGN_RPM 0
+#define ALIGN_SPEED 1
+#define ALIGN_AIR 2 // MAF or MAP, whichever the fuel estimate uses
+
+void ini_align(unsigned char n);
+void put_align(unsigned char ch, unsigned long t, unsigned short v);
+unsigned char next_align(unsigned long *t, unsigned short *v);
+
+#endif
@@ -0,0 +1,37 @@
+#include "atp.h"
+
+// The tester may only shorten the timing as far as the ECU's limits allow.
+// The shortest limits are taken for the minimum times, so requests follow
+// responses as soon as the ECU can take them. The maximum times keep their
+// current values, because the ECU needs them to answer at all.
+
+void
+pick_atp(const struct atp *lim, const struct atp *cur, struct atp *set)
+{
+	set->p2min = lim->p2min;
+	set->p2max = cur->p2max;
+	set->p3min = lim->p3min;
+	set->p3max = cur->p3max;
+	set->p4min = lim->p4min;
+}
+
+unsigned short
+p2_atp(const struct atp *a)
+{
+	// Longest wait for a response, in ms; the coarser codes above 0xf0 are capped at 1 s
+	return a->p2max <= 0xf0 ? a->p2max * 25 : 1000;
+}
+
+unsigned short
+p3_atp(const struct atp *a)
+{
+	// Gap before the next request, in whole ms
+	return (a->p3min + 1) / 2;
+}
+
+unsigned char
+p4_atp(const struct atp *a)
+{
+	// Gap between request bytes, in whole ms
+	return (a->p4min + 1) / 2;
+}
@@ -0,0 +1,27 @@
+#ifndef __atp__
+#define __atp__
+
+// KWP2000 AccessTimingParameters (service 83) identifiers
+#define ATP_LIMITS 0x00 // Read the limits the ECU supports
+#define ATP_DEFAULT 0x01 // Set the default timing
+#define ATP_CURRENT 0x02 // Read the current timing
+#define ATP_SET 0x03 // Set the given timing
+
+#define ATP_MISSES 3 // Missed responses in a row before the default timing is restored
+
+// Timing parameters as sent on the bus: P2min, P3min and P4min in 0.5 ms,
+// P2max in 25 ms up to 0xf0, P3max in 250 ms
+struct atp {
+	unsigned char p2min;
+	unsigned char p2max;
+	unsigned char p3min;
+	unsigned char p3max;
+	unsigned char p4min;
+};
+
+void pick_atp(const struct atp *lim, const struct atp *cur, struct atp *set);
+unsigned short p2_atp(const struct atp *a);
+unsigned short p3_atp(const struct atp *a);
+unsigned char p4_atp(const struct atp *a);
+
+#endif
@@ -6,6 +6,7 @@
 #include <avr/io.h>
 
 #define XTAL_FRQ 8000000lu
+#define TICK_HZ (XTAL_FRQ / 64) // Timer1 tick rate (8 us per tick)
 
 #define SET_BIT(p,i) ((p) |=  (1 << (i)))
 #define CLR_BIT(p,i) ((p) &= ~(1 << (i)))
@@ -13,6 +14,7 @@
 
 #define WDR() asm volatile("wdr"::)
 #define NOP() asm volatile("nop"::)
+#define BARRIER() asm volatile("":::"memory")
 #define RST() for(;;);
 
 void ini_avr(void);
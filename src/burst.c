@@ -0,0 +1,75 @@
+#include "avr.h"
+#include "ring.h"
+#include "sched.h"
+#include "log.h"
+#include "tlm.h"
+#include "burst.h"
+
+// A burst polls one PID back to back and keeps its samples only in the
+// history ring, so nothing but the bus limits the rate. When the burst
+// ends the ring is copied to the log, and to the telemetry link if asked;
+// this waits for the flash and the link, which is fine for a capture the
+// user stopped. A capture that fills the ring stops keeping samples, so
+// the oldest ones are not folded away unseen.
+
+unsigned char burst_pid;
+unsigned char burst_id;
+unsigned short burst_n;
+unsigned char burst_full;
+static unsigned long burst_t0;
+static unsigned long burst_t;
+
+void
+ini_burst(struct sched *e, unsigned char id)
+{
+	clr_ring();
+	burst_pid = e->pid;
+	burst_id = id;
+	burst_n = 0;
+	burst_full = 0;
+	sched_solo = e;
+}
+
+void
+put_burst(unsigned long t, unsigned short v)
+{
+	if (burst_full) return;
+	if (free_ring() < RING_REC) {
+		burst_full = 1;
+		return;
+	}
+	put_ring(burst_id, t, v);
+	if (!burst_n) burst_t0 = t;
+	burst_t = t;
+	++burst_n;
+}
+
+unsigned short
+rate_burst(void)
+{
+	// Samples per 10 s
+	if (burst_n < 2) return 0;
+	return (unsigned long long)(burst_n - 1) * 10 * TICK_HZ / (burst_t - burst_t0);
+}
+
+void
+end_burst(unsigned char tlm)
+{
+	struct ring_it it;
+	unsigned char ch;
+	unsigned long t;
+	unsigned short v;
+	
+	sched_solo = 0;
+	burst_pid = 0;
+	tlm_wait = tlm;
+	first_ring(&it);
+	while (next_ring(&it, &ch, &t, &v)) {
+		while (!room_log()) run_log();
+		put_log(ch, t, v);
+		if (tlm) put_tlm(ch, t, v);
+	}
+	sync_log();
+	if (tlm) flush_tlm();
+	tlm_wait = 0;
+}
@@ -0,0 +1,16 @@
+#ifndef __burst__
+#define __burst__
+
+#define P3_MIN 55 // Shortest ISO 9141-2 gap between a response and the next request, in ms
+
+extern unsigned char burst_pid; // PID being captured, 0 when off
+extern unsigned char burst_id; // Its value id
+extern unsigned short burst_n; // Samples captured
+extern unsigned char burst_full; // The ring had no room for the next sample
+
+void ini_burst(struct sched *e, unsigned char id);
+void put_burst(unsigned long t, unsigned short v);
+unsigned short rate_burst(void);
+void end_burst(unsigned char tlm);
+
+#endif
@@ -0,0 +1,35 @@
+#include "crc.h"
+
+unsigned char
+crc8(unsigned char crc, unsigned char d)
+{
+	unsigned char i;
+	crc ^= d;
+	for (i = 0; i < 8; ++i) {
+		crc = (crc & 0x80) ? (crc << 1) ^ 0x07 : crc << 1;
+	}
+	return crc;
+}
+
+unsigned short
+crc16(unsigned short crc, unsigned char d)
+{
+	unsigned char i;
+	crc ^= (unsigned short)d << 8;
+	for (i = 0; i < 8; ++i) {
+		crc = (crc & 0x8000) ? (crc << 1) ^ 0x1021 : crc << 1;
+	}
+	return crc;
+}
+
+unsigned char
+crc8_sae(unsigned char crc, unsigned char d)
+{
+	// SAE J1850: polynomial 0x1d, start 0xff, result inverted by the caller
+	unsigned char i;
+	crc ^= d;
+	for (i = 0; i < 8; ++i) {
+		crc = (crc & 0x80) ? (crc << 1) ^ 0x1d : crc << 1;
+	}
+	return crc;
+}
@@ -0,0 +1,8 @@
+#ifndef __crc__
+#define __crc__
+
+unsigned char crc8(unsigned char crc, unsigned char d);
+unsigned short crc16(unsigned short crc, unsigned char d);
+unsigned char crc8_sae(unsigned char crc, unsigned char d);
+
+#endif
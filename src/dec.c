@@ -0,0 +1,43 @@
+#include "dec.h"
+
+// Each digit is found by subtracting its power of ten, at most 9 times,
+// where sprintf divides by 10 for every digit in a software division
+// routine. All functions write a terminated string and return its end,
+// so a line is built by chaining them.
+
+static const unsigned short dec_pow[4] = { 10000, 1000, 100, 10 };
+
+char *
+put_str(char *s, const char *p)
+{
+	while ((*s = *p++) != 0) ++s;
+	return s;
+}
+
+char *
+put_dec(char *s, unsigned short v, unsigned char w)
+{
+	// At least w digits, zero padded
+	unsigned char i;
+	char d;
+	for (i = 0; i < 4; ++i) {
+		for (d = '0'; v >= dec_pow[i]; ++d) v -= dec_pow[i];
+		if (d != '0' || w >= 5 - i) {
+			*s++ = d;
+			w = 5; // All the digits after the first one
+		}
+	}
+	*s++ = '0' + v;
+	*s = 0;
+	return s;
+}
+
+char *
+put_sdec(char *s, signed short v, unsigned char w)
+{
+	if (v < 0) {
+		*s++ = '-';
+		return put_dec(s, -(unsigned short)v, w); // -v overflows int for -32768
+	}
+	return put_dec(s, v, w);
+}
@@ -0,0 +1,10 @@
+#ifndef __dec__
+#define __dec__
+
+// Decimal conversion for the display, without division
+
+char *put_str(char *s, const char *p);
+char *put_dec(char *s, unsigned short v, unsigned char w); // w up to 5 digits
+char *put_sdec(char *s, signed short v, unsigned char w);
+
+#endif
@@ -0,0 +1,143 @@
+#include <string.h>
+#include <avr/eeprom.h>
+#include "crc.h"
+#include "eep.h"
+
+// The EEPROM is a circular log of fixed-size records:
+//   type, len, seq (4 bytes, little endian), data, crc8
+// New records go to the next slot after the newest one, skipping slots
+// that still hold the current record of some type, so wear rotates over
+// every slot whose contents have been superseded. put_eep() only marks a
+// type dirty; run_eep() writes at most one byte per call and never waits,
+// so it can be called whenever the bus is idle.
+
+#define NO_SLOT 0xff
+
+static unsigned char live[EEP_TYPES]; // Slot of the newest record per type
+static const void *src_ptr[EEP_TYPES];
+static unsigned char src_len[EEP_TYPES];
+static unsigned short dirty;
+static unsigned long eep_seq;
+static unsigned char eep_head;
+static unsigned char rec[EEP_REC]; // Record being written
+static unsigned char rec_slot;
+static unsigned char rec_pos = EEP_REC; // EEP_REC when no write is in progress
+
+static unsigned char
+check_rec(const unsigned char *r)
+{
+	unsigned char i, crc = 0;
+	if (r[0] >= EEP_TYPES || r[1] > EEP_DATA) return 0;
+	for (i = 0; i < EEP_REC - 1; ++i) {
+		crc = crc8(crc, r[i]);
+	}
+	return crc == r[EEP_REC - 1];
+}
+
+static unsigned long
+rec_seq(const unsigned char *r)
+{
+	return r[2] | ((unsigned long)r[3] << 8) | ((unsigned long)r[4] << 16) | ((unsigned long)r[5] << 24);
+}
+
+static unsigned char
+is_live(unsigned char slot)
+{
+	unsigned char t;
+	for (t = 0; t < EEP_TYPES; ++t) {
+		if (live[t] == slot) return 1;
+	}
+	return 0;
+}
+
+void
+ini_eep(void)
+{
+	unsigned char r[EEP_REC], s;
+	unsigned long seq[EEP_TYPES], q;
+	
+	memset(live, NO_SLOT, sizeof(live));
+	eep_seq = 0;
+	eep_head = 0;
+	for (s = 0; s < EEP_SLOTS; ++s) {
+		eeprom_read_block(r, (const void *)(s * EEP_REC), EEP_REC);
+		if (!check_rec(r)) continue;
+		q = rec_seq(r);
+		if (live[r[0]] == NO_SLOT || q > seq[r[0]]) {
+			live[r[0]] = s;
+			seq[r[0]] = q;
+		}
+		if (q >= eep_seq) {
+			eep_seq = q + 1;
+			eep_head = s + 1;
+		}
+	}
+	if (eep_head == EEP_SLOTS) eep_head = 0;
+}
+
+unsigned char
+get_eep(unsigned char type, void *dst, unsigned char len)
+{
+	unsigned char r[EEP_REC];
+	if (type >= EEP_TYPES || live[type] == NO_SLOT) return 0;
+	eeprom_read_block(r, (const void *)(live[type] * EEP_REC), EEP_REC);
+	if (len > r[1]) len = r[1];
+	memcpy(dst, r + 6, len);
+	return 1;
+}
+
+void
+put_eep(unsigned char type, const void *src, unsigned char len)
+{
+	if (type >= EEP_TYPES) return;
+	src_ptr[type] = src;
+	src_len[type] = len > EEP_DATA ? EEP_DATA : len;
+	dirty |= 1u << type;
+}
+
+unsigned char
+run_eep(void)
+{
+	unsigned char t, i, crc;
+	
+	if (!eeprom_is_ready()) return 1;
+	
+	if (rec_pos == EEP_REC) { // Start the next dirty record, if any
+		if (!dirty) return 0;
+		for (t = 0; !(dirty & (1u << t)); ++t);
+		dirty &= ~(1u << t);
+		while (is_live(eep_head)) {
+			if (++eep_head == EEP_SLOTS) eep_head = 0;
+		}
+		memset(rec, 0xff, sizeof(rec));
+		rec[0] = t;
+		rec[1] = src_len[t];
+		rec[2] = eep_seq;
+		rec[3] = eep_seq >> 8;
+		rec[4] = eep_seq >> 16;
+		rec[5] = eep_seq >> 24;
+		memcpy(rec + 6, src_ptr[t], src_len[t]);
+		crc = 0;
+		for (i = 0; i < EEP_REC - 1; ++i) {
+			crc = crc8(crc, rec[i]);
+		}
+		rec[EEP_REC - 1] = crc;
+		rec_slot = eep_head;
+		rec_pos = 0;
+		++eep_seq;
+		if (++eep_head == EEP_SLOTS) eep_head = 0;
+	}
+	
+	// Write one byte, skipping bytes that already hold the right value
+	while (rec_pos < EEP_REC) {
+		unsigned char *a = (unsigned char *)(rec_slot * EEP_REC + rec_pos);
+		if (eeprom_read_byte(a) != rec[rec_pos++]) {
+			eeprom_write_byte(a, rec[rec_pos - 1]);
+			break;
+		}
+	}
+	if (rec_pos == EEP_REC) {
+		live[rec[0]] = rec_slot;
+	}
+	return 1;
+}
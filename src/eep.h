@@ -0,0 +1,27 @@
+#ifndef __eep__
+#define __eep__
+
+#define EEP_SIZE 1024
+#define EEP_REC 32 // Bytes per record slot
+#define EEP_SLOTS (EEP_SIZE / EEP_REC)
+#define EEP_DATA (EEP_REC - 7) // Payload bytes per record
+
+// Record types; the newest valid record of each type is its current value
+enum {
+	EEP_CFG,
+	EEP_TRIP,
+	EEP_MAXV,
+	EEP_DTC,
+	EEP_FUEL,
+	EEP_GEAR,
+	EEP_HIST_TRIP, // Three records each
+	EEP_HIST_LIFE = EEP_HIST_TRIP + 3,
+	EEP_TYPES = 16
+};
+
+void ini_eep(void);
+unsigned char get_eep(unsigned char type, void *dst, unsigned char len);
+void put_eep(unsigned char type, const void *src, unsigned char len);
+unsigned char run_eep(void);
+
+#endif
@@ -0,0 +1,221 @@
+#include <string.h>
+#include "snap.h"
+#include "suart.h"
+#include "elm.h"
+
+// Supports the subset of the ELM327 command set used by common PC tools,
+// plus two extensions for high-rate logging without per-request round
+// trips:
+//   AT BL pp pp ...  set the batch list (up to 8 Service 1 PIDs)
+//   AT BM            poll the batch list back to back and stream the first
+//                    two data bytes of each response as telemetry frames,
+//                    until any character is received
+
+#define ELM_LINE 24
+
+unsigned char elm_state;
+unsigned char elm_req[ELM_MAXREQ];
+unsigned char elm_req_len;
+unsigned char elm_list[ELM_MAXLIST];
+unsigned char elm_nlist;
+unsigned char elm_proto = ELM_ISO9141;
+
+static char line[ELM_LINE];
+static unsigned char line_len;
+static unsigned char echo = 1, linefeed, headers, spaces = 1;
+
+static void
+eol(void)
+{
+	puts_suart(linefeed ? "\r\n" : "\r");
+}
+
+static void
+prompt(void)
+{
+	eol();
+	puts_suart(">");
+}
+
+static void
+reply(const char *s)
+{
+	puts_suart(s);
+	eol();
+	prompt();
+}
+
+static void
+defaults(void)
+{
+	echo = 1;
+	linefeed = 0;
+	headers = 0;
+	spaces = 1;
+}
+
+static unsigned char
+hex(char c)
+{
+	if (c >= '0' && c <= '9') return c - '0';
+	if (c >= 'A' && c <= 'F') return c - 'A' + 10;
+	return 0xff;
+}
+
+static void
+put_hex(unsigned char b)
+{
+	char s[4];
+	s[0] = "0123456789ABCDEF"[b >> 4];
+	s[1] = "0123456789ABCDEF"[b & 0x0f];
+	s[2] = spaces ? ' ' : 0;
+	s[3] = 0;
+	puts_suart(s);
+}
+
+static unsigned char
+parse_hex(const char *s, unsigned char *out, unsigned char max)
+{
+	unsigned char n = 0;
+	while (s[0] && s[1] && n < max) {
+		if (hex(s[0]) > 15 || hex(s[1]) > 15) return 0xff;
+		out[n++] = (hex(s[0]) << 4) | hex(s[1]);
+		s += 2;
+	}
+	return n;
+}
+
+static void
+at_command(const char *c)
+{
+	if (!strcmp(c, "Z") || !strcmp(c, "WS") || !strcmp(c, "D")) {
+		defaults();
+		if (c[0] == 'D') {
+			reply("OK");
+		}
+		else {
+			eol();
+			reply("ELM327 v1.5");
+		}
+	}
+	else if (!strcmp(c, "I")) reply("ELM327 v1.5");
+	else if (!strcmp(c, "@1")) reply("OBD-II Reader");
+	else if (!strcmp(c, "DP")) reply(elm_proto == ELM_VPW ? "SAE J1850 VPW" : elm_proto == ELM_KWP ? "ISO 14230-4 (KWP 5BAUD)" : "ISO 9141-2");
+	else if (!strcmp(c, "DPN")) {
+		char s[2] = { '0' + elm_proto, 0 };
+		reply(s);
+	}
+	else if (!strcmp(c, "RV")) {
+		struct obd_vals v;
+		char s[6];
+		get_snap(&v);
+		v.batt = (v.batt + 50) / 100; // In tenths of a volt
+		s[0] = '0' + v.batt / 100;
+		s[1] = '0' + v.batt / 10 % 10;
+		s[2] = '.';
+		s[3] = '0' + v.batt % 10;
+		s[4] = 'V';
+		s[5] = 0;
+		reply(s[0] == '0' ? s + 1 : s);
+	}
+	else if (c[0] == 'E' && (c[1] == '0' || c[1] == '1') && !c[2]) { echo = c[1] - '0'; reply("OK"); }
+	else if (c[0] == 'L' && (c[1] == '0' || c[1] == '1') && !c[2]) { linefeed = c[1] - '0'; reply("OK"); }
+	else if (c[0] == 'H' && (c[1] == '0' || c[1] == '1') && !c[2]) { headers = c[1] - '0'; reply("OK"); }
+	else if (c[0] == 'S' && (c[1] == '0' || c[1] == '1') && !c[2]) { spaces = c[1] - '0'; reply("OK"); }
+	else if ((c[0] == 'S' || c[0] == 'T') && c[1] == 'P') {
+		// The protocol is found at power-up, so accept automatic and the one in use
+		if (!strcmp(c + 2, "0") || (c[2] == '0' + elm_proto && !c[3]) || (c[2] == 'A' && c[3] == '0' + elm_proto && !c[4])) reply("OK"); else reply("?");
+	}
+	else if (!strncmp(c, "ST", 2) || !strncmp(c, "AT", 2) || !strcmp(c, "M0") || !strcmp(c, "M1")) reply("OK");
+	else if (!strncmp(c, "BL", 2)) {
+		unsigned char n = parse_hex(c + 2, elm_list, ELM_MAXLIST);
+		if (n == 0xff) {
+			elm_nlist = 0;
+			reply("?");
+		}
+		else {
+			elm_nlist = n;
+			reply("OK");
+		}
+	}
+	else if (!strcmp(c, "BM") && elm_nlist) {
+		puts_suart("OK");
+		eol();
+		elm_state = ELM_BATCH;
+	}
+	else reply("?");
+}
+
+static void
+command(void)
+{
+	unsigned char n;
+	
+	if (!line_len) {
+		prompt();
+		return;
+	}
+	line[line_len] = 0;
+	line_len = 0;
+	
+	if (line[0] == 'A' && line[1] == 'T') {
+		at_command(line + 2);
+		return;
+	}
+	n = parse_hex(line, elm_req, ELM_MAXREQ);
+	if (n == 0 || n == 0xff) {
+		reply("?");
+		return;
+	}
+	elm_req_len = n; // Sent on the bus by the main loop, which calls reply_elm()
+}
+
+void
+put_elm(unsigned char c)
+{
+	if (elm_state == ELM_BATCH) { // Any character ends batch mode
+		elm_state = ELM_CMD;
+		prompt();
+		return;
+	}
+	elm_state = ELM_CMD;
+	if (elm_req_len) return; // Busy with a request
+	if (echo) {
+		char s[2] = { c, 0 };
+		puts_suart(s);
+	}
+	if (c == '\r') {
+		command();
+	}
+	else if (c > ' ' && line_len < ELM_LINE - 1) {
+		line[line_len++] = c >= 'a' && c <= 'z' ? c - 'a' + 'A' : c;
+	}
+}
+
+void
+reply_elm(const unsigned char *msg, unsigned char n)
+{
+	unsigned char i = 0;
+	
+	// msg is a whole message: 3 header bytes, data, checksum or CRC
+	if (n < 4) return;
+	if (!headers) {
+		i = 3;
+		--n;
+	}
+	for (; i < n; ++i) {
+		put_hex(msg[i]);
+	}
+	eol();
+}
+
+void
+done_elm(unsigned char n)
+{
+	if (!n) {
+		puts_suart("NO DATA");
+		eol();
+	}
+	elm_req_len = 0;
+	prompt();
+}
@@ -0,0 +1,26 @@
+#ifndef __elm__
+#define __elm__
+
+// ELM327 compatible command interpreter for the host link
+
+#define ELM_OFF 0 // Host link carries binary telemetry
+#define ELM_CMD 1 // Interpreting AT and hex commands
+#define ELM_BATCH 2 // Streaming the batch PID list as telemetry frames
+#define ELM_MAXREQ 7
+#define ELM_MAXLIST 8
+#define ELM_VPW 2 // ELM327 protocol numbers
+#define ELM_ISO9141 3
+#define ELM_KWP 4
+
+extern unsigned char elm_state;
+extern unsigned char elm_req[ELM_MAXREQ]; // Pending OBD request data
+extern unsigned char elm_req_len;
+extern unsigned char elm_list[ELM_MAXLIST]; // Batch PID list (Service 1)
+extern unsigned char elm_nlist;
+extern unsigned char elm_proto; // Protocol of the vehicle bus
+
+void put_elm(unsigned char c);
+void reply_elm(const unsigned char *msg, unsigned char n);
+void done_elm(unsigned char n);
+
+#endif
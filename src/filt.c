@@ -0,0 +1,83 @@
+#include "snap.h"
+#include "filt.h"
+
+// Filters work on the raw response value, before scaling, so every input
+// is unsigned. Each costs the same for every sample: the EMA is one add,
+// one subtract and two shifts; the medians are a fixed set of compares.
+
+struct filt {
+	unsigned char kind;
+	unsigned char n; // Samples seen, up to 5
+	unsigned short h[5]; // Last samples, newest first
+	unsigned long acc; // EMA state, scaled by 2^k
+};
+
+static struct filt filt[NUM_VALS];
+
+#define SWAP(a, b) do { if (a > b) { unsigned short s_ = a; a = b; b = s_; } } while (0)
+
+static unsigned short
+med3(unsigned short a, unsigned short b, unsigned short c)
+{
+	SWAP(a, b);
+	SWAP(b, c);
+	SWAP(a, b);
+	return b;
+}
+
+static unsigned short
+med5(const unsigned short *h)
+{
+	unsigned short a = h[0], b = h[1], c = h[2], d = h[3], e = h[4];
+	
+	// Sorting network for 5 inputs; the median ends up in c
+	SWAP(a, b);
+	SWAP(d, e);
+	SWAP(c, e);
+	SWAP(c, d);
+	SWAP(a, d);
+	SWAP(a, c);
+	SWAP(b, e);
+	SWAP(b, d);
+	SWAP(b, c);
+	return c;
+}
+
+void
+set_filt(unsigned char id, unsigned char kind)
+{
+	if (id >= NUM_VALS) return;
+	filt[id].kind = kind;
+	filt[id].n = 0;
+}
+
+unsigned short
+run_filt(unsigned char id, unsigned short v)
+{
+	struct filt *f;
+	unsigned char k;
+	
+	if (id >= NUM_VALS) return v;
+	f = &filt[id];
+	if (f->kind & 0x10) {
+		k = f->kind & 0x0f;
+		if (!f->n) {
+			f->acc = (unsigned long)v << k;
+			f->n = 1;
+		}
+		else {
+			f->acc += v - (f->acc >> k);
+		}
+		return f->acc >> k;
+	}
+	if (f->kind == FILT_NONE) return v;
+	
+	f->h[4] = f->h[3];
+	f->h[3] = f->h[2];
+	f->h[2] = f->h[1];
+	f->h[1] = f->h[0];
+	f->h[0] = v;
+	if (f->n < 5) ++f->n;
+	if (f->kind == FILT_MED3) return f->n < 3 ? v : med3(f->h[0], f->h[1], f->h[2]);
+	return f->n < 5 ? v : med5(f->h);
+}
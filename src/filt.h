@@ -0,0 +1,12 @@
+#ifndef __filt__
+#define __filt__
+
+#define FILT_NONE 0
+#define FILT_MED3 1 // Median of the last 3 samples
+#define FILT_MED5 2 // Median of the last 5 samples
+#define FILT_EMA(k) (0x10 | (k)) // Exponential moving average, alpha = 1 / 2^k
+
+void set_filt(unsigned char id, unsigned char kind);
+unsigned short run_filt(unsigned char id, unsigned short v);
+
+#endif
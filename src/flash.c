@@ -0,0 +1,78 @@
+#include "avr.h"
+#include "spi.h"
+#include "flash.h"
+
+// wr_flash() and er_flash() only start the operation; callers poll
+// busy_flash() before the next one instead of waiting here.
+
+#define CS_LOW() CLR_BIT(PORTB, SPI_SS)
+#define CS_HIGH() SET_BIT(PORTB, SPI_SS)
+
+static void
+cmd_addr(unsigned char cmd, unsigned long a)
+{
+	CS_LOW();
+	xfer_spi(cmd);
+	xfer_spi(a >> 16);
+	xfer_spi(a >> 8);
+	xfer_spi(a);
+}
+
+static void
+write_enable(void)
+{
+	CS_LOW();
+	xfer_spi(0x06);
+	CS_HIGH();
+}
+
+void
+ini_flash(void)
+{
+	CS_LOW();
+	xfer_spi(0xab); // Release from power-down
+	CS_HIGH();
+	while (busy_flash());
+}
+
+unsigned char
+busy_flash(void)
+{
+	unsigned char s;
+	CS_LOW();
+	xfer_spi(0x05); // Read status register 1
+	s = xfer_spi(0);
+	CS_HIGH();
+	return s & 1;
+}
+
+void
+rd_flash(unsigned long a, void *buf, unsigned short n)
+{
+	unsigned char *p = buf;
+	cmd_addr(0x03, a);
+	while (n--) {
+		*p++ = xfer_spi(0);
+	}
+	CS_HIGH();
+}
+
+void
+wr_flash(unsigned long a, const void *buf, unsigned short n)
+{
+	const unsigned char *p = buf;
+	write_enable();
+	cmd_addr(0x02, a); // Page program
+	while (n--) {
+		xfer_spi(*p++);
+	}
+	CS_HIGH();
+}
+
+void
+er_flash(unsigned long a)
+{
+	write_enable();
+	cmd_addr(0x20, a); // 4 KB sector erase
+	CS_HIGH();
+}
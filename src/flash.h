@@ -0,0 +1,14 @@
+#ifndef __flash__
+#define __flash__
+
+#define FLASH_SIZE 0x200000lu // 2 MB SPI NOR flash (W25Q16 or similar)
+#define FLASH_PAGE 256 // A program operation must not cross a page
+#define FLASH_SECTOR 4096 // Smallest erasable unit
+
+void ini_flash(void);
+unsigned char busy_flash(void);
+void rd_flash(unsigned long a, void *buf, unsigned short n);
+void wr_flash(unsigned long a, const void *buf, unsigned short n);
+void er_flash(unsigned long a);
+
+#endif
@@ -0,0 +1,92 @@
+#include "avr.h"
+#include "eep.h"
+#include "stats.h"
+#include "fuel.h"
+
+// Fuel flow follows from the air flow at stoichiometric mixture (14.7:1)
+// and a gasoline density of 740 g/L:
+//   L/h = MAF (g/s) * 3600 / (14.7 * 740) = MAF * 0.331
+// Without a MAF sensor the air flow is estimated from the ideal gas law:
+//   MAF (g/s) = RPM / 120 * MAP (kPa) / IAT (K) * VE * displacement (L) * 28.97 / 8.314
+// Air flow uses the PID 10 scale (g/s * 100) and fuel rates are in cL/h.
+// The division by the intake temperature is replaced by a reciprocal that
+// is only recomputed when a new IAT sample arrives. Power is estimated
+// from the fuel flow with a specific consumption of 300 g/kWh:
+//   kW = MAF (g/s) / 14.7 * 3600 / 300 = MAF * 0.816
+
+#define SD_K (FUEL_VE * FUEL_DISP * 1000lu / 13452) // VE * displacement * 28.97 / 8.314 / 120 * 2^8
+#define MAF_K 339 // 0.331 * 2^10
+#define POWER_K 535 // 0.00816 * 2^16
+
+unsigned char fuel_mode;
+unsigned long long fuel_sum; // Sum of rate * time, in cL/h * 128 ticks
+static unsigned short iat_recip = (1lu << 20) / 293; // 2^20 / IAT (K), 20 C until measured
+static unsigned long last_t;
+static unsigned long save_t;
+
+void
+ini_fuel(unsigned char mode)
+{
+	fuel_mode = mode;
+	get_eep(EEP_FUEL, &fuel_sum, sizeof(fuel_sum));
+}
+
+void
+clr_fuel(void)
+{
+	fuel_sum = 0;
+	put_eep(EEP_FUEL, &fuel_sum, sizeof(fuel_sum));
+}
+
+void
+iat_fuel(signed char iat)
+{
+	iat_recip = (1lu << 20) / (iat + 273);
+}
+
+unsigned short
+sd_fuel(unsigned short rpm, unsigned char map)
+{
+	unsigned long x = ((unsigned long)rpm * map >> 6) * SD_K >> 8;
+	x = (x * iat_recip) >> 14;
+	return x > 0xffff ? 0xffff : x;
+}
+
+unsigned short
+rate_fuel(unsigned short maf)
+{
+	return (unsigned long)maf * MAF_K >> 10;
+}
+
+unsigned short
+power_fuel(unsigned short maf)
+{
+	return (unsigned long)maf * POWER_K >> 16;
+}
+
+void
+put_fuel(unsigned long t, unsigned short rate)
+{
+	unsigned long dt = t - last_t;
+	
+	if (!last_t || dt > STATS_GAP) dt = 0;
+	last_t = t;
+	fuel_sum += (unsigned long)rate * (dt >> 7);
+	
+	// Saved with the same cadence as the trip statistics
+	if (!rate && save_t != trip.on_t) {
+		save_t = trip.on_t;
+		put_eep(EEP_FUEL, &fuel_sum, sizeof(fuel_sum));
+	}
+	else if (trip.on_t - save_t >= STATS_SAVE) {
+		save_t = trip.on_t;
+		put_eep(EEP_FUEL, &fuel_sum, sizeof(fuel_sum));
+	}
+}
+
+unsigned long
+ml_fuel(void)
+{
+	// cL/h * 128 ticks to mL: * 10 * 128 / (3600 * TICK_HZ)
+	return fuel_sum * 16 / 5625000;
+}
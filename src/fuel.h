@@ -0,0 +1,25 @@
+#ifndef __fuel__
+#define __fuel__
+
+// Engine constants for the speed-density estimate, used when there is no
+// MAF sensor
+#define FUEL_DISP 200 // Displacement, in cL
+#define FUEL_VE 85 // Volumetric efficiency, in percent
+
+#define FUEL_NONE 0
+#define FUEL_MAF 1 // From the mass air flow, PID 10
+#define FUEL_SD 2 // Speed-density from MAP, IAT and RPM, PIDs 0B, 0F and 0C
+
+extern unsigned char fuel_mode;
+extern unsigned long long fuel_sum;
+
+void ini_fuel(unsigned char mode);
+void clr_fuel(void);
+void iat_fuel(signed char iat);
+unsigned short sd_fuel(unsigned short rpm, unsigned char map);
+unsigned short rate_fuel(unsigned short maf);
+unsigned short power_fuel(unsigned short maf);
+void put_fuel(unsigned long t, unsigned short rate);
+unsigned long ml_fuel(void);
+
+#endif
@@ -0,0 +1,102 @@
+#include <string.h>
+#include "avr.h"
+#include "eep.h"
+#include "gear.h"
+
+// RPM and speed come from the resampling grid, so each pair belongs to
+// the same moment. A pair is only used when the RPM was steady since the
+// previous grid point, which leaves out shifts and clutch slip.
+//
+// Ratios are clustered online: a sample close to a cluster moves its
+// center by 1/8 of the difference, anything else starts a new cluster in a
+// free slot or in place of the least seen unconfirmed one. Confirmed
+// clusters sorted by falling ratio are gears 1, 2, ...
+
+struct gears gears;
+static unsigned short last_rpm;
+static unsigned char gear;
+static unsigned char gear_dirty;
+static unsigned char engine_on;
+
+void
+ini_gear(void)
+{
+	get_eep(EEP_GEAR, &gears, sizeof(gears));
+}
+
+void
+clr_gear(void)
+{
+	// Forget the learned ratios, after a gearbox or tyre size change
+	memset(&gears, 0, sizeof(gears));
+	gear = 0;
+	put_eep(EEP_GEAR, &gears, sizeof(gears));
+}
+
+static void
+learn_gear(unsigned short q)
+{
+	unsigned char i, j, k = GEAR_MAX;
+	unsigned short d, best = 0xffff;
+	
+	for (i = 0; i < GEAR_MAX; ++i) {
+		if (!gears.ratio[i]) continue;
+		d = q > gears.ratio[i] ? q - gears.ratio[i] : gears.ratio[i] - q;
+		if (d < best) {
+			best = d;
+			k = i;
+		}
+	}
+	if (k < GEAR_MAX && best <= gears.ratio[k] >> GEAR_TOL) {
+		gears.ratio[k] += ((long)q - gears.ratio[k]) / 8;
+		if (gears.n[k] < 255 && ++gears.n[k] == GEAR_CONF) gear_dirty = 1;
+	}
+	else {
+		k = GEAR_MAX;
+		for (i = 0; i < GEAR_MAX; ++i) {
+			if (!gears.ratio[i] || (gears.n[i] < GEAR_CONF && (k == GEAR_MAX || gears.n[i] < gears.n[k]))) k = i;
+			if (!gears.ratio[i]) break;
+		}
+		if (k == GEAR_MAX) return; // All gears confirmed
+		gears.ratio[k] = q;
+		gears.n[k] = 1;
+		k = GEAR_MAX + 1; // Not a gear yet
+	}
+	
+	// Gear number is the count of confirmed clusters with a higher ratio
+	gear = 0;
+	if (k < GEAR_MAX && gears.n[k] >= GEAR_CONF) {
+		gear = 1;
+		for (j = 0; j < GEAR_MAX; ++j) {
+			if (gears.n[j] >= GEAR_CONF && gears.ratio[j] > gears.ratio[k]) ++gear;
+		}
+	}
+}
+
+unsigned char
+put_gear(unsigned short rpm, unsigned char speed)
+{
+	unsigned long q;
+	unsigned short d = rpm > last_rpm ? rpm - last_rpm : last_rpm - rpm;
+	
+	if (speed < GEAR_MIN_SPEED || rpm < GEAR_MIN_RPM) {
+		gear = 0;
+	}
+	else if (d * 100ul <= (unsigned long)rpm * GEAR_STEADY) {
+		q = ((unsigned long)rpm << GEAR_SHIFT) / speed;
+		learn_gear(q > 0xffff ? 0xffff : q);
+	}
+	last_rpm = rpm;
+	
+	// Newly confirmed gears are saved at once, the cluster centers when the engine stops
+	if (rpm) engine_on = 1;
+	else if (engine_on) {
+		engine_on = 0;
+		gear_dirty = 1;
+	}
+	if (gear_dirty) {
+		put_eep(EEP_GEAR, &gears, sizeof(gears));
+		gear_dirty = 0;
+	}
+	return gear;
+}
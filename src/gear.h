@@ -0,0 +1,24 @@
+#ifndef __gear__
+#define __gear__
+
+#define GEAR_MAX 6 // Forward gears that can be learned
+#define GEAR_SHIFT 4 // Ratio is (rpm << GEAR_SHIFT) / speed
+#define GEAR_MIN_SPEED 10 // Slower samples are not used, in km/h
+#define GEAR_MIN_RPM 900
+#define GEAR_STEADY 5 // Largest RPM change between grid points, in percent
+#define GEAR_TOL 4 // A ratio within 1/2^GEAR_TOL of a cluster belongs to it
+#define GEAR_CONF 32 // Samples before a cluster is shown as a gear
+
+// One EEPROM record
+struct gears {
+	unsigned short ratio[GEAR_MAX]; // Cluster centers, 0 if unused
+	unsigned char n[GEAR_MAX]; // Samples seen, saturating
+};
+
+extern struct gears gears;
+
+void ini_gear(void);
+void clr_gear(void);
+unsigned char put_gear(unsigned short rpm, unsigned char speed);
+
+#endif
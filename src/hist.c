@@ -0,0 +1,114 @@
+#include <string.h>
+#include "avr.h"
+#include "eep.h"
+#include "tlm.h"
+#include "hist.h"
+
+// Each load sample adds the time since the previous one to the bin of the
+// current RPM and load. Each bin keeps the part of a unit it has not
+// counted yet, so short stays add up in their own bin; the time is
+// scaled to 1/65536 of a unit with one division.
+// Each histogram is kept in EEPROM as three records of up to 12 counters.
+
+struct hist hist_trip;
+struct hist hist_life;
+static unsigned long hist_t; // Time of the last sample
+static unsigned long hist_run; // Engine time since the last save
+static unsigned char hist_on; // Engine running
+
+static void
+get_hist(unsigned char type, struct hist *h)
+{
+	unsigned char i;
+	for (i = 0; i < HIST_BINS; i += HIST_REC) {
+		get_eep(type++, h->n + i, (HIST_BINS - i < HIST_REC ? HIST_BINS - i : HIST_REC) * 2);
+	}
+}
+
+static void
+save_hist(unsigned char type, struct hist *h)
+{
+	unsigned char i;
+	for (i = 0; i < HIST_BINS; i += HIST_REC) {
+		put_eep(type++, h->n + i, (HIST_BINS - i < HIST_REC ? HIST_BINS - i : HIST_REC) * 2);
+	}
+}
+
+void
+ini_hist(void)
+{
+	get_hist(EEP_HIST_TRIP, &hist_trip);
+	get_hist(EEP_HIST_LIFE, &hist_life);
+}
+
+void
+clr_hist(void)
+{
+	memset(&hist_trip, 0, sizeof(hist_trip));
+	save_hist(EEP_HIST_TRIP, &hist_trip);
+}
+
+static void
+add_hist(struct hist *h, unsigned char bin, unsigned long dt, unsigned long unit)
+{
+	unsigned long s = (dt << 8) / (unit >> 8) + h->frac[bin]; // dt is at most HIST_GAP
+	h->frac[bin] = s;
+	s >>= 16;
+	h->n[bin] = s > 0xffffu - h->n[bin] ? 0xffff : h->n[bin] + s;
+}
+
+void
+put_hist(unsigned long t, unsigned short rpm, unsigned char load)
+{
+	unsigned long dt = t - hist_t;
+	unsigned char bin;
+	
+	if (!hist_t || dt > HIST_GAP) dt = 0;
+	hist_t = t;
+	
+	if (rpm) {
+		bin = rpm < HIST_RPM * 1000 ? rpm / 1000 : HIST_RPM - 1;
+		bin = bin * HIST_LOAD + (load < 100 ? load / (100 / HIST_LOAD) : HIST_LOAD - 1);
+		add_hist(&hist_trip, bin, dt, HIST_TRIP_UNIT);
+		add_hist(&hist_life, bin, dt, HIST_LIFE_UNIT);
+		hist_on = 1;
+		hist_run += dt;
+		if (hist_run < HIST_SAVE) return;
+	}
+	else if (!hist_on) {
+		return;
+	}
+	
+	// Saved when the engine stops, and now and then while it runs
+	hist_on = rpm != 0;
+	hist_run = 0;
+	save_hist(EEP_HIST_TRIP, &hist_trip);
+	save_hist(EEP_HIST_LIFE, &hist_life);
+}
+
+void
+share_hist(const struct hist *h, unsigned char *rpm, unsigned char *load)
+{
+	// Percent of the time in each quarter of the RPM bins and in each load bin
+	unsigned long r[4] = { 0 }, l[HIST_LOAD] = { 0 }, sum = 0;
+	unsigned char i;
+	
+	for (i = 0; i < HIST_BINS; ++i) {
+		r[i / (HIST_BINS / 4)] += h->n[i];
+		l[i % HIST_LOAD] += h->n[i];
+		sum += h->n[i];
+	}
+	for (i = 0; i < 4; ++i) {
+		rpm[i] = sum ? r[i] * 100 / sum : 0;
+		load[i] = sum ? l[i] * 100 / sum : 0;
+	}
+}
+
+unsigned char
+tlm_hist(unsigned char part)
+{
+	// Parts 0-1 are the trip histogram, 2-3 the lifetime one, half each
+	const struct hist *h = part & 2 ? &hist_life : &hist_trip;
+	unsigned char row = (part & 1) * (HIST_RPM / 2);
+	return hist_tlm(part >> 1, row, h->n + row * HIST_LOAD, HIST_BINS / 2);
+}
@@ -0,0 +1,28 @@
+#ifndef __hist__
+#define __hist__
+
+#define HIST_RPM 8 // RPM bins of 1000 RPM, the last one open ended
+#define HIST_LOAD 4 // Load bins of 25%
+#define HIST_BINS (HIST_RPM * HIST_LOAD)
+#define HIST_TRIP_UNIT TICK_HZ // Trip counts are seconds
+#define HIST_LIFE_UNIT (60 * TICK_HZ) // Lifetime counts are minutes
+#define HIST_GAP (2 * TICK_HZ) // Longest gap between load samples that is counted
+#define HIST_SAVE (600 * TICK_HZ) // Save every 10 minutes of engine time
+#define HIST_REC 12 // Counters per EEPROM record
+
+// Counters are indexed [rpm bin * HIST_LOAD + load bin] and saturate
+struct hist {
+	unsigned short n[HIST_BINS];
+	unsigned short frac[HIST_BINS]; // Time not yet counted, in 1/65536 of a unit
+};
+
+extern struct hist hist_trip;
+extern struct hist hist_life;
+
+void ini_hist(void);
+void clr_hist(void);
+void put_hist(unsigned long t, unsigned short rpm, unsigned char load);
+void share_hist(const struct hist *h, unsigned char *rpm, unsigned char *load);
+unsigned char tlm_hist(unsigned char part);
+
+#endif
@@ -0,0 +1,101 @@
+#include "crc.h"
+#include "j1850.h"
+
+// Symbols are given to the decoder as (level, width) pairs when the bus
+// changes level; end_vpw() covers the passive time after the last edge,
+// which has no edge to end it. The decoder knows nothing about the pins or
+// the timer, so the same code runs on the host with a simulated bus.
+
+static unsigned char vpw_buf[J1850_MAX];
+static unsigned char vpw_len; // Whole bytes received
+static unsigned char vpw_bits; // Bits of the byte being received
+static unsigned char vpw_byte;
+static unsigned char vpw_in; // Inside a frame
+static unsigned char vpw_ready; // Length of a complete frame, 0 if none
+
+unsigned char
+crc_j1850(const unsigned char *p, unsigned char n)
+{
+	unsigned char crc = 0xff;
+	while (n--) {
+		crc = crc8_sae(crc, *p++);
+	}
+	return ~crc;
+}
+
+unsigned char
+enc_vpw(const unsigned char *p, unsigned char n, unsigned char *sym)
+{
+	// Widths of the symbols of a frame, SOF first; the frame ends by
+	// leaving the bus passive
+	unsigned char i, j, k = 0, b;
+	sym[k++] = VPW_SOF;
+	for (i = 0; i < n; ++i) {
+		for (j = 0; j < 8; ++j) {
+			b = (p[i] << j) & 0x80;
+			if (k & 1) sym[k++] = b ? VPW_LONG : VPW_SHORT; // Passive
+			else sym[k++] = b ? VPW_SHORT : VPW_LONG; // Active
+		}
+	}
+	return k;
+}
+
+static void
+done_vpw(void)
+{
+	if (vpw_in && !vpw_bits && vpw_len >= 2 && !vpw_ready) {
+		vpw_ready = vpw_len;
+	}
+	vpw_in = 0;
+}
+
+void
+put_vpw(unsigned char active, unsigned short w)
+{
+	// A symbol of level active that lasted w ticks has ended
+	unsigned char b;
+	
+	if (active && w >= VPW_SOF_MIN) {
+		done_vpw();
+		if (w <= VPW_SOF_MAX) { // Start of frame
+			vpw_in = 1;
+			vpw_len = 0;
+			vpw_bits = 0;
+		}
+		return;
+	}
+	if (!vpw_in) return;
+	if (!active && w >= VPW_EOD) {
+		done_vpw();
+		return;
+	}
+	b = (w >= VPW_MID) ^ active;
+	vpw_byte = vpw_byte << 1 | b;
+	if (++vpw_bits == 8) {
+		vpw_bits = 0;
+		if (vpw_len == J1850_MAX) vpw_in = 0; // Too long
+		else vpw_buf[vpw_len++] = vpw_byte;
+	}
+}
+
+unsigned char
+end_vpw(unsigned short idle)
+{
+	// The bus has been passive for idle ticks since the last edge
+	if (vpw_in && idle >= VPW_EOD) done_vpw();
+	return vpw_ready;
+}
+
+unsigned char
+get_vpw(unsigned char *msg, unsigned char max)
+{
+	// Take a complete frame, CRC included; frames with a bad CRC are dropped
+	unsigned char i, n = vpw_ready;
+	vpw_ready = 0;
+	if (!n || crc_j1850(vpw_buf, n - 1) != vpw_buf[n - 1]) return 0;
+	if (n > max) n = max;
+	for (i = 0; i < n; ++i) {
+		msg[i] = vpw_buf[i];
+	}
+	return n;
+}
@@ -0,0 +1,29 @@
+#ifndef __j1850__
+#define __j1850__
+
+// SAE J1850 VPW symbol timing, in Timer1 ticks of 8 us. Each bit is one
+// symbol, passive and active in turn: a short passive or a long active
+// symbol is a 0, a long passive or a short active symbol a 1. A 0 holds
+// the bus active longer, so it wins arbitration and lower headers go first.
+#define VPW_SHORT 8 // 64 us
+#define VPW_LONG 16 // 128 us
+#define VPW_SOF 25 // 200 us, active
+#define VPW_MID 12 // 96 us: shorter symbols are short
+#define VPW_SOF_MIN 21 // 163 us: longer active symbols start a frame
+#define VPW_SOF_MAX 30 // 239 us
+#define VPW_EOD 21 // 163 us: a longer passive symbol ends the frame
+#define VPW_IFS 38 // 300 us of idle bus before a new frame
+
+#define VPW_RX_PIN 3 // PD3, high while the bus is active
+#define VPW_TX_PIN 6 // PA6, drives the bus active
+
+#define J1850_MAX 12 // Frame bytes, CRC included
+#define J1850_SYMS (1 + 8 * J1850_MAX) // Symbols of the longest frame
+
+unsigned char crc_j1850(const unsigned char *p, unsigned char n);
+unsigned char enc_vpw(const unsigned char *p, unsigned char n, unsigned char *sym);
+void put_vpw(unsigned char active, unsigned short w);
+unsigned char end_vpw(unsigned short idle);
+unsigned char get_vpw(unsigned char *msg, unsigned char max);
+
+#endif
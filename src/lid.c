@@ -0,0 +1,111 @@
+#include <string.h>
+#include "avr.h"
+#include "lid.h"
+
+// Many KWP2000 ECUs return dozens of values in one Service 21 response.
+// Where those blocks are, and how their fields scale, differs from car to
+// car, so a vehicle is picked by the start of its VIN and its fields are
+// listed in lid_fields. Each field is rescaled to the Mode 01 encoding of
+// the PID it replaces and goes through the same decoder, so the rest of
+// the firmware cannot tell a block field from a polled PID.
+//
+// To add a vehicle, add its VIN prefix to lid_cars and its fields to
+// lid_fields with that index. The entry below only shows the format: "I"
+// never starts a real VIN.
+
+static const char lid_cars[][LID_VIN + 1] PROGMEM = {
+	"I", // Example: block 01 holding RPM, coolant, speed and load
+};
+
+static const struct lid_field lid_fields[] PROGMEM = {
+	// car lid off flags pid mul shift add
+	{ 0, 0x01, 0, LID_WORD | LID_OUT2, 0x0C, 4, 0, 0 }, // RPM, 1 RPM per bit
+	{ 0, 0x01, 2, 0, 0x05, 3, 2, 40 - 48 }, // Coolant, 0.75 C per bit from -48 C
+	{ 0, 0x01, 3, 0, 0x0D, 1, 0, 0 }, // Speed, km/h
+	{ 0, 0x01, 4, 0, 0x04, 1, 0, 0 }, // Load, 1/255 per bit
+};
+
+#define LID_CARS (sizeof(lid_cars) / sizeof(lid_cars[0]))
+#define LID_FIELDS (sizeof(lid_fields) / sizeof(lid_fields[0]))
+
+unsigned char lid_car = 0xff;
+
+unsigned char
+ini_lid(const char *vin)
+{
+	unsigned char i;
+	for (i = 0; i < LID_CARS; ++i) {
+		if (!strncmp_P(vin, lid_cars[i], strlen_P(lid_cars[i]))) {
+			lid_car = i;
+			return 1;
+		}
+	}
+	return 0;
+}
+
+unsigned char
+covers_lid(unsigned char pid)
+{
+	// The block of this vehicle that already delivers the PID, 0 for none
+	unsigned char i;
+	for (i = 0; i < LID_FIELDS; ++i) {
+		if (pgm_read_byte(&lid_fields[i].car) == lid_car && pgm_read_byte(&lid_fields[i].pid) == pid) return pgm_read_byte(&lid_fields[i].lid);
+	}
+	return 0;
+}
+
+unsigned char
+next_lid(unsigned char lid, unsigned char *len)
+{
+	// Next block after lid used by this vehicle, 0 for none, and how many
+	// bytes of it are needed
+	unsigned char i, l, next = 0, end = 0;
+	for (i = 0; i < LID_FIELDS; ++i) {
+		if (pgm_read_byte(&lid_fields[i].car) != lid_car) continue;
+		l = pgm_read_byte(&lid_fields[i].lid);
+		if (l > lid && (!next || l < next)) {
+			next = l;
+			end = 0;
+		}
+		if (l == next) {
+			l = pgm_read_byte(&lid_fields[i].off) + (pgm_read_byte(&lid_fields[i].flags) & LID_WORD ? 2 : 1);
+			if (l > end) end = l;
+		}
+	}
+	*len = end;
+	return next;
+}
+
+unsigned char
+get_lid(unsigned char lid, const unsigned char *d, unsigned char n, unsigned char *i, unsigned char *pid, unsigned char *out)
+{
+	// Next field of block lid from d[n], starting at field *i: its PID and
+	// the PID data bytes
+	const struct lid_field *f;
+	unsigned char flags, off;
+	long v;
+	
+	for (; *i < LID_FIELDS; ++*i) {
+		f = &lid_fields[*i];
+		if (pgm_read_byte(&f->car) != lid_car || pgm_read_byte(&f->lid) != lid) continue;
+		flags = pgm_read_byte(&f->flags);
+		off = pgm_read_byte(&f->off);
+		if (off + (flags & LID_WORD ? 2 : 1) > n) continue;
+		if (flags & LID_WORD) v = flags & LID_SIGNED ? (long)(signed short)(d[off] << 8 | d[off + 1]) : (long)(d[off] << 8 | d[off + 1]);
+		else v = flags & LID_SIGNED ? (signed char)d[off] : d[off];
+		v = (v * pgm_read_word(&f->mul) >> pgm_read_byte(&f->shift)) + (signed short)pgm_read_word(&f->add);
+		if (v < 0) v = 0;
+		*pid = pgm_read_byte(&f->pid);
+		if (flags & LID_OUT2) {
+			if (v > 0xffff) v = 0xffff;
+			out[0] = v >> 8;
+			out[1] = v;
+		}
+		else {
+			out[0] = v > 0xff ? 0xff : v;
+		}
+		++*i;
+		return 1;
+	}
+	return 0;
+}
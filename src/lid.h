@@ -0,0 +1,33 @@
+#ifndef __lid__
+#define __lid__
+
+#define LID_MAXLEN 48 // Longest block read, in data bytes
+#define LID_VIN 8 // Longest VIN prefix that selects a vehicle
+#define LID_ECU 0x10 // Engine ECU address for block reads and timing requests
+
+// Field flags
+#define LID_WORD 0x01 // Two bytes, big endian; one otherwise
+#define LID_SIGNED 0x02
+#define LID_OUT2 0x04 // The PID it stands in for has two data bytes
+
+// One field of a Service 21 block, turned into the Service 1 PID it
+// stands in for: pid value = (raw * mul >> shift) + add
+struct lid_field {
+	unsigned char car; // Index into the vehicle table
+	unsigned char lid; // Local identifier of the block
+	unsigned char off; // Byte offset after the identifier
+	unsigned char flags;
+	unsigned char pid;
+	unsigned short mul;
+	unsigned char shift;
+	signed short add;
+};
+
+extern unsigned char lid_car; // Vehicle found by ini_lid(), 0xff for none
+
+unsigned char ini_lid(const char *vin);
+unsigned char covers_lid(unsigned char pid);
+unsigned char next_lid(unsigned char lid, unsigned char *len);
+unsigned char get_lid(unsigned char lid, const unsigned char *d, unsigned char n, unsigned char *i, unsigned char *pid, unsigned char *out);
+
+#endif
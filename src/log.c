@@ -0,0 +1,168 @@
+#include <string.h>
+#include "crc.h"
+#include "flash.h"
+#include "log.h"
+
+// Samples are packed into one of two RAM blocks while the other one is
+// being programmed, so put_log() never waits for the flash. run_log()
+// moves at most one flash operation forward per call.
+
+static unsigned char log_buf[2][LOG_BLOCK];
+static unsigned char log_fill; // Buffer being filled
+static unsigned char log_len; // Bytes used in the buffer being filled
+static unsigned char log_full[2]; // Buffer waiting to be programmed
+static unsigned long log_addr; // Next block address in flash
+static unsigned long log_erased; // End of the erased area ahead of log_addr
+static unsigned long log_t; // Time of the last sample, in log units
+static unsigned short log_seq;
+static unsigned char log_on;
+unsigned short log_drop; // Samples lost because both buffers were full
+
+unsigned char
+check_log(const unsigned char *b)
+{
+	unsigned char i, crc = 0;
+	if (b[0] != LOG_SYNC) return 0;
+	for (i = 0; i < LOG_BLOCK - 1; ++i) {
+		crc = crc8(crc, b[i]);
+	}
+	return crc == b[LOG_BLOCK - 1];
+}
+
+static void
+close_block(void)
+{
+	unsigned char *b = log_buf[log_fill];
+	unsigned char i, crc = 0;
+	for (i = 0; i < LOG_BLOCK - 1; ++i) {
+		crc = crc8(crc, b[i]);
+	}
+	b[LOG_BLOCK - 1] = crc;
+	log_full[log_fill] = 1;
+	log_fill ^= 1;
+	log_len = 0;
+}
+
+static unsigned char
+open_block(unsigned char type, unsigned long t)
+{
+	unsigned char *b = log_buf[log_fill];
+	if (log_full[log_fill]) return 0;
+	memset(b, 0xff, LOG_BLOCK);
+	b[0] = LOG_SYNC;
+	b[1] = type;
+	b[2] = log_seq;
+	b[3] = log_seq >> 8;
+	b[4] = t;
+	b[5] = t >> 8;
+	b[6] = t >> 16;
+	b[7] = t >> 24;
+	++log_seq;
+	log_t = t;
+	log_len = LOG_HEAD;
+	return 1;
+}
+
+void
+ini_log(unsigned long t, const char *vin, const unsigned char *pids, unsigned char n)
+{
+	unsigned char b[LOG_BLOCK];
+	unsigned char *p;
+	
+	// Find the first erased block; anything before it is kept
+	log_on = 0;
+	log_seq = 0;
+	for (log_addr = 0; log_addr < FLASH_SIZE; log_addr += LOG_BLOCK) {
+		rd_flash(log_addr, b, 1);
+		if (b[0] == 0xff) break;
+	}
+	if (log_addr >= FLASH_SIZE) return;
+	log_erased = log_addr % FLASH_SECTOR ? (log_addr | (FLASH_SECTOR - 1)) + 1 : log_addr;
+	if (log_addr) {
+		rd_flash(log_addr - LOG_BLOCK, b, LOG_BLOCK);
+		if (check_log(b)) log_seq = (b[2] | (b[3] << 8)) + 1;
+	}
+	
+	// Start the session with a header block describing the samples
+	log_fill = 0;
+	log_full[0] = log_full[1] = 0;
+	open_block(LOG_HDR, t >> LOG_TSHIFT);
+	p = log_buf[log_fill] + LOG_HEAD;
+	memcpy(p, vin, LOG_VIN);
+	p += LOG_VIN;
+	if (n > LOG_BLOCK - LOG_HEAD - LOG_VIN - 2) n = LOG_BLOCK - LOG_HEAD - LOG_VIN - 2;
+	*p++ = n;
+	memcpy(p, pids, n);
+	close_block();
+	log_on = 1;
+}
+
+void
+put_log(unsigned char id, unsigned long t, unsigned short v)
+{
+	unsigned char *b;
+	unsigned long dt;
+	
+	if (!log_on) return;
+	t >>= LOG_TSHIFT;
+	dt = t - log_t;
+	if (log_len && (dt > 0xffff || log_len + LOG_REC > LOG_BLOCK - 1)) {
+		close_block();
+		dt = 0;
+	}
+	if (!log_len) {
+		if (!open_block(LOG_DATA, t)) {
+			++log_drop;
+			return;
+		}
+		dt = 0;
+	}
+	b = log_buf[log_fill] + log_len;
+	b[0] = id;
+	b[1] = dt;
+	b[2] = dt >> 8;
+	b[3] = v;
+	b[4] = v >> 8;
+	log_len += LOG_REC;
+	log_t = t;
+}
+
+void
+sync_log(void)
+{
+	if (log_len > LOG_HEAD) close_block();
+}
+
+unsigned char
+run_log(void)
+{
+	unsigned char i;
+	
+	if (!log_on) return 0; // Not started yet, or the flash is full
+	if (busy_flash()) return 1;
+	i = log_full[log_fill] ? log_fill : log_fill ^ 1; // Oldest full buffer
+	if (!log_full[i]) return 0;
+	if (log_addr >= FLASH_SIZE) { // Flash is full; stop logging
+		log_on = 0;
+		log_full[0] = log_full[1] = 0;
+		return 0;
+	}
+	if (log_addr >= log_erased) {
+		er_flash(log_addr);
+		log_erased = log_addr + FLASH_SECTOR;
+		return 1;
+	}
+	wr_flash(log_addr, log_buf[i], LOG_BLOCK);
+	log_addr += LOG_BLOCK;
+	log_full[i] = 0;
+	return 1;
+}
+
+unsigned char
+room_log(void)
+{
+	// Whether put_log() can take a sample now without dropping it
+	if (!log_on) return 1;
+	if (log_len && log_len + LOG_REC <= LOG_BLOCK - 1) return 1;
+	return !log_full[log_len ? log_fill ^ 1 : log_fill];
+}
@@ -0,0 +1,34 @@
+#ifndef __log__
+#define __log__
+
+// Log layout: a sequence of LOG_BLOCK byte blocks, each starting with a
+// sync header and ending with a CRC-8 over the rest of the block, so a
+// reader can resynchronise after a block torn by a power loss.
+//   0     LOG_SYNC
+//   1     block type (LOG_HDR or LOG_DATA)
+//   2..3  block sequence number
+//   4..7  Timer1 tick of the block start >> LOG_TSHIFT
+//   8..62 payload, padded with 0xff
+//   63    CRC-8 of bytes 0..62
+// A LOG_HDR payload is the VIN (17 bytes), the number of value ids and the
+// PID of each value id. A LOG_DATA payload is a list of 5-byte samples:
+// value id, time since the previous sample (2 bytes), value (2 bytes).
+// All multi-byte fields are little endian.
+
+#define LOG_BLOCK 64
+#define LOG_SYNC 0xa5
+#define LOG_HDR 'H'
+#define LOG_DATA 'D'
+#define LOG_HEAD 8
+#define LOG_REC 5
+#define LOG_VIN 17
+#define LOG_TSHIFT 7 // Log time unit is 128 ticks (1.024 ms)
+
+void ini_log(unsigned long t, const char *vin, const unsigned char *pids, unsigned char n);
+void put_log(unsigned char id, unsigned long t, unsigned short v);
+void sync_log(void);
+unsigned char run_log(void);
+unsigned char room_log(void);
+unsigned char check_log(const unsigned char *b);
+
+#endif
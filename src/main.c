@@ -20,32 +20,137 @@
 
 #include <asf.h>
 #include <stdio.h>
+#include <util/atomic.h>
 #include "avr.h"
 #include "avr.c"
 #include "lcd.h"
 #include "lcd.c"
+#include "dec.h"
+#include "dec.c"
+#include "snap.h"
+#include "snap.c"
+#include "ring.h"
+#include "ring.c"
+#include "crc.h"
+#include "crc.c"
+#include "eep.h"
+#include "eep.c"
+#include "spi.h"
+#include "spi.c"
+#include "flash.h"
+#include "flash.c"
+#include "log.h"
+#include "log.c"
+#include "suart.h"
+#include "suart.c"
+#include "tlm.h"
+#include "tlm.c"
+#include "elm.h"
+#include "elm.c"
+#include "stats.h"
+#include "stats.c"
+#include "sched.h"
+#include "sched.c"
+#include "fuel.h"
+#include "fuel.c"
+#include "filt.h"
+#include "filt.c"
+#include "alarm.h"
+#include "alarm.c"
+#include "adc.h"
+#include "adc.c"
+#include "gear.h"
+#include "gear.c"
+#include "perf.h"
+#include "perf.c"
+#include "burst.h"
+#include "burst.c"
+#include "align.h"
+#include "align.c"
+#include "hist.h"
+#include "hist.c"
+#include "sniff.h"
+#include "sniff.c"
+#include "lid.h"
+#include "lid.c"
+#include "atp.h"
+#include "atp.c"
+#include "j1850.h"
+#include "j1850.c"
+#include "pids.h"
 
 char buf0[17];
 char buf1[17];
 
 unsigned char s1pid00[10]; // Supported PIDs
+char vin[LOG_VIN + 1]; // Vehicle identification number
+#define VAL_PID(p, id, field, len, min, max, filt, fuel, how, scale) [id] = p,
+const unsigned char val_pid[NUM_VALS] = { // PID of each value id, from 0xF0 for local values
+	PID_LIST(VAL_PID)
+	[VAL_FUEL] = 0x5E, [VAL_BATT] = 0x42, // Values the reader estimates or measures itself, under the PID a vehicle would use
+	[VAL_CRANK] = 0xF0, [VAL_OIL] = 0xF1, [VAL_EGT] = 0xF2, [VAL_BOOST] = 0xF3, [VAL_GEAR] = 0xF4, [VAL_POWER] = 0xF5
+};
+#undef VAL_PID
+struct obd_vals vals; // Latest decoded values
 
-unsigned char load; // Engine load
-signed char temperature; // Engine coolant temperature
-unsigned short rpm; // Instantaneous engine RPM
-unsigned char speed; // Instantaneous vehicle speed
+unsigned char sniffing; // Listen only: another tester owns the bus
+unsigned char kwp; // The ECU answered the init with KWP2000 key bytes
+unsigned char vpw; // The vehicle talks SAE J1850 VPW instead of using the K-line
+unsigned short p2_ms = 100; // Longest wait for a response
+unsigned short p3_ms = P3_MIN; // Shortest gap between a response and the next request
+unsigned char p4_ms = 10; // Gap between request bytes
+unsigned char atp_on; // Shorter timing negotiated with service 83
+#define BUS_MARGIN 10 // Added to P3min, except in burst captures and the performance timer
+#define KEYOFF_MISSES 10 // Requests in a row without a response, about 1 s, taken as the ignition off
+#define HOST_FRAMES 6 // Response frames kept for a host request; a VIN takes 5
 unsigned char mode;
 unsigned char page;
+#define BENCH_N 256 // Conversions timed by run_bench()
+unsigned short bench_tab, bench_calc; // Timer1 ticks for BENCH_N table and arithmetic PID decodes
+unsigned short bench_dec, bench_fmt; // Timer1 ticks for BENCH_N put_dec() and sprintf() conversions
+#define NUM_PAGES 7
 volatile unsigned char timer_flag;
+volatile unsigned long tick_base; // Timer1 ticks at the last compare match
 
 void timer_setup(void); // Setup for timer interrupt
+unsigned long get_tick(void); // Timer1 ticks since startup
+void bus_idle(unsigned short msec); // Wait between messages, doing deferred work
 void update_lcd(void);
+void show_lcd(void); // Write the lines of buf0 and buf1 that changed
 unsigned char get_key(void);
 unsigned char key_pressed(unsigned char r, unsigned char c);
 void USART_Init(unsigned int baud); // Initialize the USART
 void USART_Transmit(unsigned char data); // Transmit using the USART
 unsigned char USART_Receive(void); // Receive using the USART
-void obd_init(void); // OBDII ISO 9141-2 initialization sequence
+unsigned char USART_Receive_Timeout(unsigned char *data, unsigned short msec); // Receive, giving up after msec
+void obd_send(const unsigned char *data, unsigned char n); // Send a request message
+void obd_send_to(unsigned char ecu, const unsigned char *data, unsigned char n); // Send a request message to one ECU
+void obd_request(unsigned char service, unsigned char pid); // Send a request for one PID
+unsigned char obd_receive(unsigned char *msg, unsigned char max, unsigned short msec); // Receive one response message
+void host_input(void); // Pass characters from the host link to the ELM327 interpreter
+void host_request(void); // Run a request from the host on the bus
+void host_batch(void); // Poll the host's batch list once
+void read_vin(void); // Read the VIN using Service 9 PID 02
+unsigned char obd_valid(const unsigned char *msg, unsigned char n); // Check a response checksum
+void vpw_send(unsigned char ecu, const unsigned char *data, unsigned char n); // Send a request message on the J1850 bus
+unsigned char vpw_receive(unsigned char *msg, unsigned char max, unsigned short msec); // Receive one J1850 response message
+unsigned char vpw_probe(void); // Check for a J1850 VPW vehicle
+unsigned char supported(unsigned char pid); // Check the Service 1 PID 00 bitmap
+void put_value(unsigned char id, unsigned long t, unsigned short v); // Record a new sample
+void derive_values(unsigned long t); // Compute the values that combine several PIDs
+void decode_pid(unsigned char pid, const unsigned char *d, unsigned long t); // Decode a Service 1 response
+void decode_block(unsigned char lid, const unsigned char *d, unsigned char n, unsigned long t); // Decode a Service 21 response
+void poll_pid(unsigned char pid, unsigned char len, unsigned short min, unsigned short max); // Schedule a PID unless a block read delivers it
+void run_bench(void); // Time the PID decode and the decimal conversion on the target
+unsigned char atp_request(unsigned char tpi, const struct atp *set, struct atp *res); // Run one service 83 exchange
+void set_timing(void); // Negotiate the shortest bus timing the ECU allows
+void reset_timing(void); // Go back to the default bus timing
+void read_adc(void); // Publish new analog input readings, and record the slow ones
+unsigned char capture_pid(unsigned char i); // Start a burst capture of the next Service 1 PID
+void obd_init(void); // OBDII ISO 9141-2 initialization sequence, or J1850 VPW detection
+unsigned char listen_bus(void); // Listen for another tester at power-up
+void sniff_msg(unsigned long t); // Decode a response to another tester's request
+void sniff_bus(void); // Follow another tester's traffic for one polling round
 
 void timer_setup(void) {
 	cli();
@@ -54,35 +159,186 @@ void timer_setup(void) {
 	TCCR1B |= (1 << WGM12);
 	TIMSK |= (1 << OCIE1A);
 	sei();
-	OCR1A = 15624; // Interrupt once every 500 ms (2Hz)
-	TCCR1B |= (1 << CS12);
+	OCR1A = 62499; // Interrupt once every 500 ms (2Hz)
+	TCCR1B |= (1 << CS11) | (1 << CS10); // Prescaler 64: one tick every 8 us
 }
 
 ISR(TIMER1_COMPA_vect) {
+	tick_base += 62500;
 	timer_flag = 1;
 }
 
+unsigned long get_tick(void) {
+	unsigned long t;
+	unsigned short n;
+	ATOMIC_BLOCK(ATOMIC_RESTORESTATE) {
+		t = tick_base;
+		n = TCNT1;
+		if (GET_BIT(TIFR, OCF1A) && n < 31250) { // Counter wrapped but the ISR has not run yet
+			t += 62500;
+		}
+	}
+	return t + n;
+}
+
+void bus_idle(unsigned short msec) {
+	while (msec--) {
+		run_eep();
+		run_log();
+		read_adc();
+		host_input();
+		wait_avr(1);
+	}
+}
+
 void update_lcd(void) {
-	if (mode == 1) { // Show first 32 supported Service 1 PIDs 
+	struct obd_vals v;
+	const char *msg;
+	signed short av;
+	char *p;
+	
+	if (get_alarm(&msg, &av)) { // Alarms take over the display until they clear or a key is pressed
+		strcpy_P(buf0, msg);
+		put_sdec(put_str(buf1, "Value: "), av, 1);
+		show_lcd();
+		return;
+	}
+	
+	if (perf_state != PERF_OFF) { // Performance timer
+		unsigned long ms;
+		if (perf_state == PERF_WAIT) {
+			sprintf(buf0, "Timer: stop car");
+			buf1[0] = 0;
+		}
+		else if (perf_state == PERF_READY) {
+			sprintf(buf0, "Timer: ready");
+			buf1[0] = 0;
+		}
+		else if (perf_state == PERF_RUN) {
+			ms = (get_tick() - perf.start) / (TICK_HZ / 1000);
+			sprintf(buf0, "Timer: %lu.%lu s", ms / 1000, ms % 1000 / 100);
+			buf1[0] = 0;
+		}
+		else {
+			ms = perf.speed_t / (TICK_HZ / 1000);
+			if (ms) sprintf(buf0, "0-%u: %lu.%03lu s", PERF_SPEED, ms / 1000, ms % 1000);
+			else sprintf(buf0, "0-%u: --", PERF_SPEED);
+			ms = perf.dist_t / (TICK_HZ / 1000);
+			if (ms) sprintf(buf1, "1/4 %lu.%03lus %u", ms / 1000, ms % 1000, perf.trap);
+			else sprintf(buf1, "1/4: --");
+		}
+		show_lcd();
+		return;
+	}
+	
+	if (burst_pid) { // Burst capture and the sample rate it gets
+		unsigned short r = rate_burst();
+		sprintf(buf0, burst_full ? "Ring full PID %02X" : "Burst PID %02X", burst_pid);
+		sprintf(buf1, "%u.%u Hz n %u", r / 10, r % 10, burst_n);
+		show_lcd();
+		return;
+	}
+	
+	get_snap(&v); // Consistent copy of the values published by the bus engine
+	
+	if (mode == 1 && sniffing) { // Show the traffic followed in listen-only mode
+		sprintf(buf0, "Heard: %u", sniff_msgs);
+		sprintf(buf1, "Paired: %u", sniff_pairs);
+	}
+	else if (mode == 1) { // Show first 32 supported Service 1 PIDs 
 		sprintf(buf0, "%02X %02X %02X %02X %02X", (unsigned int)(s1pid00[0] & 0xFF), (unsigned int)(s1pid00[1] & 0xFF), (unsigned int)(s1pid00[2] & 0xFF),
 				(unsigned int)(s1pid00[3] & 0xFF), (unsigned int)(s1pid00[4] & 0xFF));
 		sprintf(buf1, "%02X %02X %02X %02X %02X", (unsigned int)(s1pid00[5] & 0xFF), (unsigned int)(s1pid00[6] & 0xFF), (unsigned int)(s1pid00[7] & 0xFF),
 				(unsigned int)(s1pid00[8] & 0xFF), (unsigned int)(s1pid00[9] & 0xFF));
 	}
+	else if (mode == 2) { // Show the time of one PID decode from the table and from the scaling, and of one number with put_dec() and sprintf(), in us
+		unsigned short a = bench_tab * 80UL / BENCH_N, b = bench_calc * 80UL / BENCH_N; // 8 us ticks to tenths of us each
+		if (a > 999) a = 999;
+		if (b > 999) b = 999;
+		sprintf(buf0, "Dec %u.%u/%u.%u us", a / 10, a % 10, b / 10, b % 10);
+		a = bench_dec * 8UL / BENCH_N;
+		b = bench_fmt * 8UL / BENCH_N;
+		if (a > 9999) a = 9999;
+		if (b > 9999) b = 9999;
+		sprintf(buf1, "Fmt %u/%u us", a, b);
+	}
 	else if (page == 0) { // Show first page: RPM and speed
-		sprintf(buf0, "RPM: %i", rpm);
-		sprintf(buf1, "KM/H: %i", speed);
+		put_dec(put_str(buf0, "RPM: "), v.rpm, 1);
+		p = put_dec(put_str(buf1, "KM/H: "), v.speed, 1);
+		while (p < buf1 + 9) *p++ = ' ';
+		p = put_str(p, " Gear ");
+		*p++ = v.gear ? '0' + v.gear : '-';
+		*p = 0;
+	}
+	else if (page == 1) { // Show second page: Engine load and engine coolant temperature
+		p = put_dec(put_str(buf0, "Load: "), v.load, 1);
+		while (p < buf0 + 9) *p++ = ' ';
+		put_str(put_dec(put_str(p, " "), v.power, 1), " kW");
+		put_sdec(put_str(buf1, "Temp: "), v.temperature, 1);
+	}
+	else if (page == 2) { // Show third page: Trip distance, average and maximum speed
+		unsigned long d = dist_stats() / 100;
+		sprintf(buf0, "Trip: %lu.%lu km", d / 10, d % 10);
+		sprintf(buf1, "Avg %u Max %u", avg_speed_stats(), trip_max.max_speed);
+	}
+	else if (page == 3 && fuel_mode == FUEL_NONE) { // Show fourth page: Fuel consumption
+		sprintf(buf0, "Fuel: no data");
+		buf1[0] = 0;
+	}
+	else if (page == 3) {
+		unsigned long m = dist_stats();
+		unsigned long f;
+		if (v.speed) { // Instantaneous, in L/100km; 99.9 fills the line
+			f = (unsigned long)v.fuel * 10 / v.speed;
+			if (f > 999) f = 999;
+			sprintf(buf0, "Fuel: %lu.%lu L/100", f / 10, f % 10);
+		}
+		else { // Stopped, in L/h
+			f = v.fuel / 10;
+			sprintf(buf0, "Fuel: %lu.%lu L/h", f / 10, f % 10);
+		}
+		f = m >= 100 ? ml_fuel() * 100 / (m / 10) : 0; // Trip average, in L/100km
+		if (f > 999) f = 999;
+		sprintf(buf1, "Trip: %lu.%lu L/100", f / 10, f % 10);
+	}
+	else if (page == 4) { // Show fifth page: Battery voltage, and its lowest value during the last engine start
+		sprintf(buf0, "Batt: %u.%02u V", v.batt / 1000, v.batt % 1000 / 10);
+		sprintf(buf1, "Crank: %u.%02u V", v.crank / 1000, v.crank % 1000 / 10);
+	}
+	else if (page == 5) { // Show sixth page: Oil pressure, exhaust gas temperature and boost
+		unsigned short oil = v.oil > 999 ? 999 : v.oil; // An open sensor reads full scale, keep it on the line
+		unsigned short egt = v.egt > 9999 ? 9999 : v.egt;
+		sprintf(buf0, "Oil %u.%u EGT %u", oil / 100, oil % 100 / 10, egt);
+		sprintf(buf1, "Boost: %i kPa", (int)v.boost - 101); // Relative to atmosphere
 	}
-	else { // Show second page: Engine load and engine coolant temperature
-		sprintf(buf0, "Load: %i", load);
-		sprintf(buf1, "Temp: %i", temperature);
+	else { // Show seventh page: Share of trip engine time per load quarter and per 2000 RPM
+		unsigned char r[4], l[4];
+		share_hist(&hist_trip, r, l);
+		sprintf(buf0, "Ld%% %u %u %u %u", l[0], l[1], l[2], l[3]);
+		sprintf(buf1, "Rpm%% %u %u %u %u", r[0], r[1], r[2], r[3]);
 	}
 	
-	clr_lcd();
-	pos_lcd(0, 0);
-	puts_lcd2(buf0);
-	pos_lcd(1, 0);
-	puts_lcd2(buf1);
+	show_lcd();
+}
+
+void show_lcd(void) {
+	// Lines are padded to the full width instead of clearing the display,
+	// and a line that reads the same as the last time is not sent at all
+	static char shown[2][17];
+	char *b;
+	unsigned char r, i;
+	
+	for (r = 0; r < 2; ++r) {
+		b = r ? buf1 : buf0;
+		if (!strcmp(b, shown[r])) {
+			continue;
+		}
+		strcpy(shown[r], b);
+		pos_lcd(r, 0);
+		for (i = 0; i < 16; ++i) {
+			put_lcd(*b ? *b++ : ' ');
+		}
+	}
 }
 
 unsigned char get_key(void) {
@@ -140,47 +396,563 @@ unsigned char USART_Receive(void) {
 	return UDR;
 }
 
+unsigned char USART_Receive_Timeout(unsigned char *data, unsigned short msec) {
+	unsigned long start = get_tick();
+	
+	// Wait for data to be received, or for the timeout to expire
+	while (!(UCSRA & (1 << RXC))) {
+		if (get_tick() - start > msec * (TICK_HZ / 1000)) {
+			return 0;
+		}
+	}
+	
+	*data = UDR;
+	return 1;
+}
+
+void obd_send(const unsigned char *data, unsigned char n) {
+	obd_send_to(0, data, n);
+}
+
+void obd_send_to(unsigned char ecu, const unsigned char *data, unsigned char n) {
+	// ISO 9141-2: 68 6A F1 <data> <checksum>
+	// KWP2000: <format> <target> F1 <data> <checksum>, to the functional
+	// OBD address 33 unless an ECU is given
+	// Each byte is echoed back by the K-line
+	unsigned char msg[3 + ELM_MAXREQ + 1] = { 0x68, 0x6A, 0xF1 };
+	unsigned char i;
+	
+	if (vpw) {
+		vpw_send(ecu, data, n);
+		return;
+	}
+	if (kwp) {
+		msg[0] = (ecu ? 0x80 : 0xC0) | n;
+		msg[1] = ecu ? ecu : 0x33;
+	}
+	for (i = 0; i < n; ++i) {
+		msg[3 + i] = data[i];
+	}
+	n += 3;
+	msg[n] = 0;
+	for (i = 0; i < n; ++i) {
+		msg[n] += msg[i];
+	}
+	while (GET_BIT(UCSRA, RXC)) { // Drop anything left from an earlier exchange
+		i = UDR;
+	}
+	for (i = 0; i <= n; ++i) {
+		if (i) {
+			wait_avr(p4_ms);
+		}
+		USART_Transmit(msg[i]);
+		USART_Receive();
+	}
+}
+
+void obd_request(unsigned char service, unsigned char pid) {
+	unsigned char data[2] = { service, pid };
+	obd_send(data, 2);
+}
+
+unsigned char obd_receive(unsigned char *msg, unsigned char max, unsigned short msec) {
+	unsigned char n = 0, c;
+	
+	if (vpw) {
+		return vpw_receive(msg, max, msec);
+	}
+	// Wait for the first byte, then take bytes until a gap longer than P1max (20 ms);
+	// bytes past max are read and dropped so the next exchange starts clean
+	if (!USART_Receive_Timeout(&c, msec)) {
+		return 0;
+	}
+	do {
+		if (n < max) {
+			msg[n++] = c;
+		}
+	} while (USART_Receive_Timeout(&c, 20));
+	return n;
+}
+
+unsigned char obd_valid(const unsigned char *msg, unsigned char n) {
+	unsigned char sum = 0;
+	
+	// The last byte is the sum of all the others, or their CRC on J1850
+	if (n < 2) {
+		return 0;
+	}
+	if (vpw) {
+		return crc_j1850(msg, n - 1) == msg[n - 1];
+	}
+	while (--n) {
+		sum += *msg++;
+	}
+	return sum == *msg;
+}
+
+void vpw_send(unsigned char ecu, const unsigned char *data, unsigned char n) {
+	// SAE J1850 VPW: 68 6A F1 <data> <crc>, or 6C <ecu> F1 to one ECU
+	// Edges are placed at running tick counts, so a late edge does not
+	// shift the ones after it
+	unsigned char msg[3 + ELM_MAXREQ + 1] = { 0x68, 0x6A, 0xF1 };
+	unsigned char sym[J1850_SYMS];
+	unsigned char i, k;
+	unsigned long t;
+	
+	if (ecu) {
+		msg[0] = 0x6C;
+		msg[1] = ecu;
+	}
+	for (i = 0; i < n; ++i) {
+		msg[3 + i] = data[i];
+	}
+	n += 3;
+	msg[n] = crc_j1850(msg, n);
+	k = enc_vpw(msg, n + 1, sym);
+	
+	// Wait for the bus to stay passive for the inter-frame space
+	t = get_tick();
+	while (get_tick() - t < VPW_IFS) {
+		if (GET_BIT(PIND, VPW_RX_PIN)) {
+			t = get_tick();
+		}
+	}
+	t = get_tick();
+	for (i = 0; i < k; ++i) {
+		if (i & 1) {
+			CLR_BIT(PORTA, VPW_TX_PIN);
+		}
+		else {
+			SET_BIT(PORTA, VPW_TX_PIN);
+		}
+		t += sym[i];
+		while ((long)(get_tick() - t) < 0) {
+			// Another node driving the bus during our passive symbol has won arbitration
+			if ((i & 1) && t - get_tick() < sym[i] - 2 && GET_BIT(PIND, VPW_RX_PIN)) {
+				return;
+			}
+		}
+	}
+	CLR_BIT(PORTA, VPW_TX_PIN);
+}
+
+unsigned char vpw_receive(unsigned char *msg, unsigned char max, unsigned short msec) {
+	// Time each level of PD3 for the decoder. Only responses to the tester
+	// are taken: 48 6B <ecu> to a functional request, or <pri> F1 <ecu>;
+	// traffic between other modules and our own requests are skipped
+	unsigned long start = get_tick(), t = start, now, w;
+	unsigned char level = GET_BIT(PIND, VPW_RX_PIN) != 0;
+	unsigned char n;
+	
+	for (;;) {
+		now = get_tick();
+		w = now - t;
+		if (w > 0xffff) {
+			w = 0xffff;
+		}
+		if ((GET_BIT(PIND, VPW_RX_PIN) != 0) != level) {
+			put_vpw(level, w);
+			level = !level;
+			t = now;
+		}
+		else if (!level && end_vpw(w)) {
+			n = get_vpw(msg, max);
+			if (n > 3 && msg[2] != 0xF1 && ((msg[0] == 0x48 && msg[1] == 0x6B) || msg[1] == 0xF1)) {
+				return n;
+			}
+		}
+		else if (now - start > msec * (TICK_HZ / 1000) && (level ? w > VPW_SOF_MAX : w >= VPW_EOD)) {
+			return 0; // Timed out between frames, or the bus is stuck active
+		}
+	}
+}
+
+unsigned char vpw_probe(void) {
+	unsigned char msg[J1850_MAX];
+	
+	// Ask for the supported PIDs and see if anything answers
+	CLR_BIT(PORTA, VPW_TX_PIN);
+	SET_BIT(DDRA, VPW_TX_PIN);
+	CLR_BIT(DDRD, VPW_RX_PIN);
+	CLR_BIT(PORTD, VPW_RX_PIN);
+	vpw = 1;
+	obd_request(0x01, 0x00);
+	if (obd_receive(msg, sizeof(msg), p2_ms) >= 6) {
+		return 1;
+	}
+	vpw = 0;
+	return 0;
+}
+
+unsigned char supported(unsigned char pid) {
+	// Bytes 5 to 8 of the response flag PIDs 01 to 20, MSB first
+	if (pid == 0 || pid > 0x20) {
+		return 0;
+	}
+	--pid;
+	return (s1pid00[5 + (pid >> 3)] & (0x80 >> (pid & 7))) != 0;
+}
+
+void put_value(unsigned char id, unsigned long t, unsigned short v) {
+	put_snap(&vals);
+	run_alarm(id, v);
+	if (burst_pid) {
+		if (id == burst_id) { // Burst samples stay in the ring until the capture ends
+			put_burst(t, v);
+			return;
+		}
+	}
+	else {
+		put_ring(id, t, v); // Keep recent history of the values that changed
+	}
+	put_log(id, t, v); // Log every sample
+	if (elm_state == ELM_OFF) { // Stream samples to the host
+		put_tlm(id, t, v);
+	}
+}
+
+void derive_values(unsigned long t) {
+	// Inputs are taken at the same grid time g; results are recorded at t,
+	// the arrival of the sample that completed the grid point
+	unsigned long g;
+	unsigned short a[ALIGN_CH], air;
+	while (next_align(&g, a)) {
+		vals.gear = put_gear(a[ALIGN_RPM], a[ALIGN_SPEED]);
+		put_value(VAL_GEAR, t, vals.gear);
+		if (fuel_mode == FUEL_NONE) {
+			continue;
+		}
+		air = fuel_mode == FUEL_MAF ? a[ALIGN_AIR] : sd_fuel(a[ALIGN_RPM], a[ALIGN_AIR]);
+		vals.power = power_fuel(air);
+		put_value(VAL_POWER, t, vals.power);
+		vals.fuel = rate_fuel(air);
+		put_fuel(g, vals.fuel);
+		put_value(VAL_FUEL, t, vals.fuel);
+	}
+}
+
+void read_adc(void) {
+	unsigned char id, rec;
+	unsigned short v;
+	while (get_adc(&id, &v, &rec)) {
+		if (id == VAL_BATT) vals.batt = v;
+		else if (id == VAL_OIL) vals.oil = v;
+		else if (id == VAL_EGT) vals.egt = v;
+		else if (id == VAL_BOOST) vals.boost = v;
+		if (rec) put_value(id, get_tick(), v);
+		else put_snap(&vals); // Display only; alarms, the ring, log and host get the slow average
+	}
+}
+
+unsigned char capture_pid(unsigned char i) {
+	// Captures the first Service 1 entry from sched[i] on, and returns its
+	// index; blocks carry several values and are passed over
+	unsigned char n, id = NUM_VALS;
+	for (n = 0; n < nsched; ++n, i = (i + 1) % nsched) {
+		if (sched[i].service != 0x01) {
+			continue;
+		}
+		for (id = 0; id < NUM_VALS && val_pid[id] != sched[i].pid; ++id);
+		if (id < NUM_VALS) {
+			break;
+		}
+	}
+	if (id < NUM_VALS) {
+		end_perf();
+		ini_burst(&sched[i], id);
+	}
+	return i;
+}
+
+unsigned char atp_request(unsigned char tpi, const struct atp *set, struct atp *res) {
+	// 83 <tpi> [P2min P2max P3min P3max P4min], answered by C3 <tpi> [the same five]
+	unsigned char req[7] = { 0x83, tpi };
+	unsigned char msg[16];
+	unsigned char len, n = 2;
+	
+	if (set) {
+		req[2] = set->p2min;
+		req[3] = set->p2max;
+		req[4] = set->p3min;
+		req[5] = set->p3max;
+		req[6] = set->p4min;
+		n = 7;
+	}
+	bus_idle(p3_ms + BUS_MARGIN);
+	obd_send_to(LID_ECU, req, n);
+	len = obd_receive(msg, sizeof(msg), p2_ms);
+	if (len < 6 || !obd_valid(msg, len) || msg[3] != 0xC3 || msg[4] != tpi) {
+		return 0; // No answer, or a negative response 7F 83 <code>
+	}
+	if (res) {
+		if (len < 11) {
+			return 0;
+		}
+		res->p2min = msg[5];
+		res->p2max = msg[6];
+		res->p3min = msg[7];
+		res->p3max = msg[8];
+		res->p4min = msg[9];
+	}
+	return 1;
+}
+
+void set_timing(void) {
+	struct atp lim, cur, set;
+	
+	// Only KWP2000 ECUs have service 83
+	if (!kwp || !atp_request(ATP_LIMITS, 0, &lim) || !atp_request(ATP_CURRENT, 0, &cur)) {
+		return;
+	}
+	pick_atp(&lim, &cur, &set);
+	
+	// Take the new timing only once the ECU reports it back
+	if (atp_request(ATP_SET, &set, 0) && atp_request(ATP_CURRENT, 0, &cur) && !memcmp(&cur, &set, sizeof(set))) {
+		p2_ms = p2_atp(&set);
+		p3_ms = p3_atp(&set);
+		p4_ms = p4_atp(&set);
+		atp_on = 1;
+	}
+	else {
+		reset_timing();
+	}
+}
+
+void reset_timing(void) {
+	p2_ms = 100;
+	p3_ms = P3_MIN;
+	p4_ms = 10;
+	atp_request(ATP_DEFAULT, 0, 0);
+	atp_on = 0;
+}
+
+void decode_block(unsigned char lid, const unsigned char *d, unsigned char n, unsigned long t) {
+	// Each field is rescaled to the PID it stands in for
+	unsigned char i = 0, pid, out[2];
+	while (get_lid(lid, d, n, &i, &pid, out)) {
+		decode_pid(pid, out, t);
+	}
+}
+
+void poll_pid(unsigned char pid, unsigned char len, unsigned short min, unsigned short max) {
+	if (!covers_lid(pid)) {
+		add_sched(0x01, pid, len, min, max);
+	}
+}
+
+#define TABLE_PID(p, id, field, len, min, max, filt, fuel, how, scale) how##_DEF(p, scale)
+PID_LIST(TABLE_PID)
+#undef TABLE_PID
+
+void decode_pid(unsigned char pid, const unsigned char *d, unsigned long t) {
+	// Raw values go through the value's filter before they are scaled as
+	// the PID list says
+	unsigned short r;
+	switch (pid) {
+#define DECODE_PID(p, id, field, len, min, max, filt, fuel, how, scale) \
+	case p: \
+		r = run_filt(id, len == 2 ? d[0] * 256 + d[1] : d[0]); \
+		vals.field = how(p, scale, r); \
+		put_value(id, t, vals.field); \
+		break;
+	PID_LIST(DECODE_PID)
+#undef DECODE_PID
+	default:
+		return;
+	}
+	
+	// Everything else that follows a new value
+	switch (pid) {
+	case 0x01:
+		vals.dtcs = d[0] & 0x7F; // MIL is bit 7 of A, the trouble code count is the rest
+		break;
+	case 0x04:
+		put_hist(t, vals.rpm, vals.load);
+		break;
+	case 0x0B:
+		if (fuel_mode == FUEL_SD) {
+			put_align(ALIGN_AIR, t, vals.map);
+		}
+		break;
+	case 0x0C:
+		put_stats(t, vals.speed, vals.rpm);
+		put_align(ALIGN_RPM, t, vals.rpm);
+		if (crank_adc(vals.rpm, &vals.crank)) {
+			put_value(VAL_CRANK, t, vals.crank);
+		}
+		break;
+	case 0x0D:
+		put_stats(t, vals.speed, vals.rpm);
+		put_align(ALIGN_SPEED, t, vals.speed);
+		if (perf_state != PERF_OFF) {
+			put_perf(t, vals.speed);
+		}
+		break;
+	case 0x0F:
+		iat_fuel(vals.iat);
+		break;
+	case 0x10:
+		put_align(ALIGN_AIR, t, vals.maf);
+		break;
+	}
+}
+
+void run_bench(void) {
+	// The table and arithmetic decodes of the one table PID, over every raw
+	// value, then put_dec() and sprintf() of values up to five digits into
+	// buf1, which the display rewrites anyway. Interrupts stay on, so the
+	// software UART keeps its timing and all figures include the same
+	// interrupt load.
+	volatile unsigned char r; // Keeps the results from being optimized away
+	unsigned short i;
+	unsigned long t;
+	t = get_tick();
+	for (i = 0; i < BENCH_N; ++i) {
+		r = PID_TABLE(0x04, SCALE_PERCENT, i);
+	}
+	bench_tab = get_tick() - t;
+	t = get_tick();
+	for (i = 0; i < BENCH_N; ++i) {
+		r = PID_CALC(0x04, SCALE_PERCENT, i);
+	}
+	bench_calc = get_tick() - t;
+	(void)r;
+	t = get_tick();
+	for (i = 0; i < BENCH_N; ++i) {
+		put_dec(buf1, i * 257, 1);
+	}
+	bench_dec = get_tick() - t;
+	t = get_tick();
+	for (i = 0; i < BENCH_N; ++i) {
+		sprintf(buf1, "%u", i * 257);
+	}
+	bench_fmt = get_tick() - t;
+}
+
+void host_input(void) {
+	unsigned char c;
+	while (get_suart(&c)) {
+		put_elm(c);
+	}
+}
+
+void host_request(void) {
+	// The frames are printed once the exchange is over: writing one to the
+	// host at 9600 baud takes longer than the gap before the next arrives
+	unsigned char msg[HOST_FRAMES][16];
+	unsigned char len[HOST_FRAMES];
+	unsigned char i, n = 0;
+	
+	if (sniffing) { // Never transmit
+		done_elm(0);
+		return;
+	}
+	bus_idle(p3_ms + BUS_MARGIN);
+	obd_send(elm_req, elm_req_len);
+	while (n < HOST_FRAMES && (len[n] = obd_receive(msg[n], sizeof(msg[n]), n ? 60 : p2_ms)) != 0) {
+		++n;
+	}
+	for (i = 0; i < n; ++i) {
+		reply_elm(msg[i], len[i]);
+	}
+	done_elm(n);
+}
+
+void host_batch(void) {
+	unsigned char msg[16];
+	unsigned char len, i;
+	
+	// 48 6B <ecu> 41 <pid> A [B] <checksum>
+	for (i = 0; i < elm_nlist && elm_state == ELM_BATCH; ++i) {
+		bus_idle(p3_ms + BUS_MARGIN);
+		obd_request(0x01, elm_list[i]);
+		len = obd_receive(msg, sizeof(msg), p2_ms);
+		if (len >= 7) {
+			put_tlm(i, get_tick(), len > 7 ? (msg[5] << 8) | msg[6] : msg[5]);
+		}
+	}
+	flush_tlm();
+}
+
+void read_vin(void) {
+	// The response is 5 messages 48 6B <ecu> 49 02 <n> A B C D <checksum>
+	// carrying 3 bytes of padding followed by the 17 VIN characters
+	unsigned char msg[11];
+	unsigned char i, j, k = 0;
+	
+	for (i = 0; i < LOG_VIN; ++i) {
+		vin[i] = '?';
+	}
+	vin[LOG_VIN] = 0;
+	
+	obd_request(0x09, 0x02);
+	for (i = 0; i < 5; ++i) {
+		if (obd_receive(msg, sizeof(msg), 100) != sizeof(msg)) {
+			return; // Not supported
+		}
+		for (j = 6; j < 10; ++j, ++k) {
+			if (k >= 3) {
+				vin[k - 3] = msg[j];
+			}
+		}
+	}
+}
+
 void obd_init(void) {
-	// Using ISO 9141-2 Protocol with 5-baud initialization
+	// Using ISO 9141-2 Protocol with 5-baud initialization, or SAE J1850
+	// VPW when nothing answers on the K-line
+	unsigned char response;
 	
 	sprintf(buf0, "Initializing...");
 	pos_lcd(0, 0);
 	puts_lcd2(buf0);
 	
-	DDRD |= (1 << 1); // Set Pin PD1 as output
-	
-	PORTD |= (1 << 1); // Write 1 to PD1
-	
-	wait_avr(2610); // Wait 2610 ms for ECU to reset fully
-	
-	// Send a byte 33 hex at 5 baud
-	PORTD &= ~(1 << 1);
-	wait_avr(200);
-	PORTD |= (1 << 1);
-	wait_avr(400);
-	PORTD &= ~(1 << 1);
-	wait_avr(400);
-	PORTD |= (1 << 1);
-	wait_avr(400);
-	PORTD &= ~(1 << 1);
-	wait_avr(400);
-	PORTD |= (1 << 1);
-	wait_avr(200);
-	
-	// Initialize serial connection
-	// ~10400 baud --> UBRR = 47
-	// 8-bit character size
-	// No parity bit, 1 stop bit
-	USART_Init(47);
-	
-	// Wait for response: Byte 55 hex
-	unsigned char response = USART_Receive();
+	for (;;) {
+		DDRD |= (1 << 1); // Set Pin PD1 as output
+		
+		PORTD |= (1 << 1); // Write 1 to PD1
+		
+		wait_avr(2610); // Wait 2610 ms for ECU to reset fully
+		
+		// Send a byte 33 hex at 5 baud
+		PORTD &= ~(1 << 1);
+		wait_avr(200);
+		PORTD |= (1 << 1);
+		wait_avr(400);
+		PORTD &= ~(1 << 1);
+		wait_avr(400);
+		PORTD |= (1 << 1);
+		wait_avr(400);
+		PORTD &= ~(1 << 1);
+		wait_avr(400);
+		PORTD |= (1 << 1);
+		wait_avr(200);
+		
+		// Initialize serial connection
+		// ~10400 baud --> UBRR = 47
+		// 8-bit character size
+		// No parity bit, 1 stop bit
+		USART_Init(47);
+		
+		// Wait for response: Byte 55 hex, within W1max (300 ms)
+		if (USART_Receive_Timeout(&response, 300)) {
+			break;
+		}
+		UCSRB = 0; // Give PD0 and PD1 back to the port
+		if (vpw_probe()) {
+			elm_proto = ELM_VPW;
+			clr_lcd();
+			return;
+		}
+	}
 	
 	// Receive two key bytes
 	// 08 08, 94 94 for ISO 9141
 	// 8F E9, 8F 6B, 8F 6D, 8F EF for KWP
 	unsigned char keyByte1 = USART_Receive();
 	unsigned char keyByte2 = USART_Receive();
+	kwp = keyByte1 == 0x8F || keyByte2 == 0x8F;
+	elm_proto = kwp ? ELM_KWP : ELM_ISO9141;
 	
 	wait_avr(40);
 	
@@ -197,179 +969,285 @@ void obd_init(void) {
 	clr_lcd();
 }
 
+unsigned char listen_bus(void) {
+	unsigned long start;
+	
+	// Receive only, with PD1 left floating; hold key 5 to stay listen-only
+	CLR_BIT(DDRD, 1);
+	CLR_BIT(PORTD, 1);
+	USART_Init(47);
+	CLR_BIT(UCSRB, TXEN);
+	start = get_tick();
+	while (get_tick() - start < SNIFF_LISTEN * (TICK_HZ / 1000)) {
+		if (get_key() == 5) {
+			return 1;
+		}
+		if (GET_BIT(UCSRA, RXC)) {
+			run_sniff(get_tick());
+			if (GET_BIT(UCSRA, DOR)) drop_sniff(); // Read before UDR, which clears it
+			put_sniff(UDR, get_tick());
+		}
+		run_sniff(get_tick());
+		if (sniff_msgs) { // Someone else is talking
+			return 1;
+		}
+	}
+	UCSRB = 0;
+	return 0;
+}
+
+void sniff_msg(unsigned long t) {
+	// 48 6B <ecu> 41 <pid> <data> <checksum>, decoded if the PID is one we poll ourselves
+	struct sched *e;
+	if (!run_sniff(t) || sniff_rsp[3] != 0x41) {
+		return;
+	}
+	for (e = sched; e < sched + nsched && (e->service != 0x01 || e->pid != sniff_rsp[4]); ++e);
+	if (e < sched + nsched && sniff_rlen == 6 + e->len) {
+		decode_pid(e->pid, sniff_rsp + 5, t);
+		derive_values(t);
+	}
+}
+
+void sniff_bus(void) {
+	unsigned char n;
+	unsigned long t;
+	// Bytes wait in the USART while the other jobs run; a message is
+	// closed before the first byte after a gap is added. The USART holds
+	// two bytes, so a job that runs longer than about 2 ms at 10400 baud
+	// loses one, and the message it belongs to is dropped.
+	for (n = 0; n < 65; ++n) {
+		while (GET_BIT(UCSRA, RXC)) {
+			t = get_tick();
+			sniff_msg(t);
+			if (GET_BIT(UCSRA, DOR)) drop_sniff(); // Read before UDR, which clears it
+			put_sniff(UDR, t);
+		}
+		sniff_msg(get_tick());
+		bus_idle(1);
+	}
+}
+
 int main (void)
 {
 	board_init();
 	ini_lcd();
-	obd_init();
+	ini_alarm();
+	ini_eep();
 	timer_setup();
-	
-	cli(); // Disable interrupts
+	sniffing = listen_bus();
+	if (!sniffing) {
+		obd_init();
+	}
 	
 	wait_avr(100);
 	
 	unsigned char keyPressed;
+	unsigned char lastKey = 0;
+	const char *alarmMsg;
+	signed short alarmValue;
+	unsigned char msg[6 + LID_MAXLEN];
+	unsigned char len;
+	unsigned long t;
+	struct sched *e;
+	unsigned char cycle = 0;
+	unsigned char burstSel = 0; // Schedule entry captured by the next burst
+	unsigned char histPart = 0; // Histogram part sent next
+	unsigned char misses = 0; // Requests in a row without a response
 	mode = 0; // Show vehicle information / supported PIDs
-	page = 0; // Show RPM and speed / engine load and engine coolant temperature
-	
-	unsigned char s1pid04[7]; // Engine load
-	unsigned char s1pid05[7]; // Engine coolant temperature
-	unsigned char s1pid0c[8]; // Engine RPM
-	unsigned char s1pid0d[7]; // Vehicle speed
+	page = 0; // Show RPM and speed / engine load and engine coolant temperature / trip / fuel
+	get_eep(EEP_CFG, &page, sizeof(page)); // Restore the last page shown
+	if (page >= NUM_PAGES) {
+		page = 0;
+	}
+	ini_stats(); // Continue the trip saved before power-off
+	ini_gear(); // Gear ratios learned on earlier drives
+	ini_hist(); // RPM and load histograms of the trip and of the engine's life
 	
 	// OBDII Initialized; Send Service 1 PID 00 request message
-	// 68 6A F1 01 00 C4
-	unsigned char receive;
-	
-	USART_Transmit(0x68);
-	receive = USART_Receive();
-	wait_avr(10);
-	USART_Transmit(0x6A);
-	receive = USART_Receive();
-	wait_avr(10);
-	USART_Transmit(0xF1);
-	receive = USART_Receive();
-	wait_avr(10);
-	USART_Transmit(0x01);
-	receive = USART_Receive();
-	wait_avr(10);
-	USART_Transmit(0x00);
-	receive = USART_Receive();
-	wait_avr(10);
-	USART_Transmit(0xC4);
-	receive = USART_Receive();
-	
-	// Service 1 PID 00 response
-	int i = 0;
-	for (i = 0; i < 10; ++i) {
-		s1pid00[i] = USART_Receive();
-	}
-	
-	sei(); // Enable interrupts
+	if (!sniffing) {
+		obd_request(0x01, 0x00);
+		
+		// Service 1 PID 00 response
+		obd_receive(s1pid00, sizeof(s1pid00), p2_ms);
+	}
 	
-	while (1) {
+	// Shorten the gaps between messages where the ECU allows it
+	if (!sniffing) {
+		set_timing();
+	}
+	
+	// The VIN names the vehicle in the log and picks its block layout
+	if (!sniffing) {
 		wait_avr(65);
-		
-		// Request Service 1 PID 04: Engine load
-		// 68 6A F1 01 04 C8
-		USART_Transmit(0x68);
-		receive = USART_Receive();
-		wait_avr(10);
-		USART_Transmit(0x6A);
-		receive = USART_Receive();
-		wait_avr(10);
-		USART_Transmit(0xF1);
-		receive = USART_Receive();
-		wait_avr(10);
-		USART_Transmit(0x01);
-		receive = USART_Receive();
-		wait_avr(10);
-		USART_Transmit(0x04);
-		receive = USART_Receive();
-		wait_avr(10);
-		USART_Transmit(0xC8);
-		receive = USART_Receive();
-		
-		// Service 1 PID 04 response
-		for (i = 0; i < 7; ++i) {
-			s1pid04[i] = USART_Receive();
+		read_vin();
+	}
+	
+	// Read the vehicle's Service 21 blocks as often as possible
+	if (!sniffing && ini_lid(vin)) {
+		unsigned char lid = 0, n;
+		while ((lid = next_lid(lid, &n)) != 0) {
+			add_sched(0x21, lid, n, 0, 0);
 		}
-		
-		wait_avr(65);
-		
-		// Request Service 1 PID 05: Engine coolant temperature
-		// 68 6A F1 01 05 C9
-		USART_Transmit(0x68);
-		receive = USART_Receive();
-		wait_avr(10);
-		USART_Transmit(0x6A);
-		receive = USART_Receive();
-		wait_avr(10);
-		USART_Transmit(0xF1);
-		receive = USART_Receive();
-		wait_avr(10);
-		USART_Transmit(0x01);
-		receive = USART_Receive();
-		wait_avr(10);
-		USART_Transmit(0x05);
-		receive = USART_Receive();
-		wait_avr(10);
-		USART_Transmit(0xC9);
-		receive = USART_Receive();
-		
-		// Service 1 PID 05 response
-		for (i = 0; i < 7; ++i) {
-			s1pid05[i] = USART_Receive();
+	}
+	
+	// Estimate fuel use from the MAF if there is one, or else from MAP and IAT
+	if (sniffing) { // Decode whatever the other tester asks for, without estimates that need particular PIDs
+		ini_fuel(FUEL_NONE);
+	}
+	else if (supported(0x10)) {
+		ini_fuel(FUEL_MAF);
+	}
+	else if (supported(0x0B) && supported(0x0F)) {
+		ini_fuel(FUEL_SD);
+	}
+	else {
+		ini_fuel(FUEL_NONE);
+	}
+	
+	// Poll the PIDs of the list that this fuel estimate uses, with their filters
+	// (RPM and speed as often as possible, the rest as fast as they change)
+#define POLL_PID(p, id, field, len, min, max, filt, fuel, how, scale) \
+	if (sniffing || fuel == PID_ANY || fuel == fuel_mode) { \
+		poll_pid(p, len, min, max); \
+		set_filt(id, filt); \
+	}
+	PID_LIST(POLL_PID)
+#undef POLL_PID
+	ini_align(fuel_mode == FUEL_NONE ? 2 : 3); // RPM and speed, and the air flow input if there is one
+	
+	// Start a new data log session for this vehicle
+	ini_spi();
+	ini_flash();
+	ini_log(get_tick(), vin, val_pid, NUM_VALS);
+	ini_suart();
+	ini_adc();
+	
+	while (1) {
+		if (elm_req_len) {
+			host_request();
 		}
-		
-		wait_avr(65);
-		
-		// Request Service 1 PID 0C: Engine RPM
-		// 68 6A F1 01 0C D0
-		USART_Transmit(0x68);
-		receive = USART_Receive();
-		wait_avr(10);
-		USART_Transmit(0x6A);
-		receive = USART_Receive();
-		wait_avr(10);
-		USART_Transmit(0xF1);
-		receive = USART_Receive();
-		wait_avr(10);
-		USART_Transmit(0x01);
-		receive = USART_Receive();
-		wait_avr(10);
-		USART_Transmit(0x0C);
-		receive = USART_Receive();
-		wait_avr(10);
-		USART_Transmit(0xD0);
-		receive = USART_Receive();
-		
-		// Service 1 PID 0C response
-		for (i = 0; i < 8; ++i) {
-			s1pid0c[i] = USART_Receive();
+		if (elm_state == ELM_BATCH && !sniffing) { // The host gets the whole bus
+			if ((cycle++ & 31) == 0) {
+				map_tlm(elm_list, elm_nlist);
+			}
+			host_batch();
+			continue;
 		}
 		
-		wait_avr(65);
-		
-		// Request Service 1 PID 0D: Vehicle speed
-		// 68 6A F1 01 0D D1
-		USART_Transmit(0x68);
-		receive = USART_Receive();
-		wait_avr(10);
-		USART_Transmit(0x6A);
-		receive = USART_Receive();
-		wait_avr(10);
-		USART_Transmit(0xF1);
-		receive = USART_Receive();
-		wait_avr(10);
-		USART_Transmit(0x01);
-		receive = USART_Receive();
-		wait_avr(10);
-		USART_Transmit(0x0D);
-		receive = USART_Receive();
-		wait_avr(10);
-		USART_Transmit(0xD1);
-		receive = USART_Receive();
-		
-		// Service 1 PID 0D response
-		for (i = 0; i < 7; ++i) {
-			s1pid0d[i] = USART_Receive();
+		if (sniffing) {
+			sniff_bus();
+		}
+		else {
+			bus_idle(burst_pid || perf_state != PERF_OFF ? p3_ms : p3_ms + BUS_MARGIN);
+			
+			// Request the PID or block that is due next; 48 6B <ecu> 41 <pid> <data> <checksum>,
+			// or <format> F1 <ecu> 61 <lid> <data> <checksum>
+			e = next_sched(get_tick());
+			if (e) { // None when nothing the vehicle supports is scheduled
+				if (e->service == 0x21) {
+					msg[0] = 0x21;
+					msg[1] = e->pid;
+					obd_send_to(LID_ECU, msg, 2);
+				}
+				else {
+					obd_request(0x01, e->pid);
+				}
+				len = obd_receive(msg, sizeof(msg), p2_ms);
+				t = get_tick(); // Time of arrival
+				if (len) {
+					misses = 0;
+				}
+				else {
+					if (misses < 0xff) ++misses;
+					if (atp_on && misses == ATP_MISSES) { // The ECU cannot keep up with the shorter timing
+						reset_timing();
+					}
+					if (misses == KEYOFF_MISSES) { // Ignition off: no sample with RPM 0 will come, so save as if one had
+						put_stats(t, 0, 0);
+						put_hist(t, 0, 0);
+						put_fuel(t, 0);
+					}
+				}
+				// A block may be longer than the fields used from it; a PID has its exact length
+				if ((e->service == 0x21 ? len >= 6 + e->len : len == 6 + e->len) && obd_valid(msg, len) && msg[3] == e->service + 0x40 && msg[4] == e->pid) {
+					if (e->service == 0x21) {
+						decode_block(e->pid, msg + 5, len - 6, t);
+					}
+					else {
+						decode_pid(e->pid, msg + 5, t);
+					}
+					put_sched(e, msg + 5);
+					derive_values(t);
+				}
+			}
+		}
+		if (alarm_new) { // Show a new alarm right away
+			alarm_new = 0;
+			update_lcd();
 		}
 		
 		keyPressed = get_key();
-		if (keyPressed == 1) {
-			page ^= 1;
+		if (keyPressed == lastKey) { // Act once per key press
+			keyPressed = 0;
+		}
+		else {
+			lastKey = keyPressed;
+		}
+		if (keyPressed && get_alarm(&alarmMsg, &alarmValue)) { // Any key dismisses the alarm
+			ack_alarm();
+			update_lcd();
+		}
+		else if (keyPressed == 1) {
+			page = (page + 1) % NUM_PAGES;
+			put_eep(EEP_CFG, &page, sizeof(page));
 		}
-		else if (keyPressed == 16) {
-			mode ^= 1;
+		else if (keyPressed == 2) { // Start or leave the performance timer
+			if (burst_pid) end_burst(elm_state == ELM_OFF);
+			if (perf_state == PERF_OFF) {
+				e = find_sched(0x01, 0x0D);
+				ini_perf(e ? e : find_sched(0x21, covers_lid(0x0D)));
+			}
+			else end_perf();
+		}
+		else if (keyPressed == 3) { // Start or stop a burst capture
+			if (burst_pid) end_burst(elm_state == ELM_OFF);
+			else if (nsched) burstSel = capture_pid(burstSel);
+			update_lcd();
+		}
+		else if (keyPressed == 7) { // Burst capture of the next PID
+			if (burst_pid) end_burst(elm_state == ELM_OFF);
+			if (nsched) burstSel = capture_pid((burstSel + 1) % nsched);
+			update_lcd();
+		}
+		else if (keyPressed == 4) {
+			clr_stats(); // Start a new trip
+			clr_fuel();
+			clr_hist();
+		}
+		else if (keyPressed == 8) { // Learn the gear ratios again
+			clr_gear();
+			vals.gear = 0;
+		}
+		else if (keyPressed == 16) { // Supported PIDs, then the decode timing
+			mode = (mode + 1) % 3;
+			if (mode == 2) run_bench();
 		}
 		
-		load = s1pid04[5] * 100 / 255; // Engine load is A * 100 / 255, in percent
-		temperature = s1pid05[5] - 40; // Engine coolant temperature is A - 40, in Celsius
-		rpm = (s1pid0c[5] * 256 + s1pid0c[6]) / 4; // RPM is ((A * 256) + B) / 4
-		speed = s1pid0d[5]; // Vehicle speed is A, in Km/h
-		while (!timer_flag);
-		timer_flag = 0;
-		update_lcd();
+		// Refresh the display and flush telemetry at 2 Hz
+		if (timer_flag) {
+			timer_flag = 0;
+			if (elm_state == ELM_OFF) {
+				flush_tlm(); // Samples first; the frames below queue behind them
+				if ((cycle & 31) == 0) {
+					map_tlm(val_pid, NUM_VALS);
+				}
+				else if ((cycle & 7) == 4 && tlm_hist(histPart)) { // A quarter of the histograms every 4 s
+					histPart = (histPart + 1) & 3;
+				}
+				++cycle;
+			}
+			update_lcd();
+		}
 	}
 }
@@ -0,0 +1,76 @@
+#include "avr.h"
+#include "sched.h"
+#include "perf.h"
+
+// While a run is timed only vehicle speed is polled, which gives the
+// shortest time between samples the bus allows. Each threshold is crossed
+// somewhere between two samples; the crossing time is interpolated
+// linearly between them. Distance is the trapezoidal sum of the speed
+// samples, so it is kept doubled.
+
+unsigned char perf_state;
+struct perf perf;
+static unsigned long last_t;
+static unsigned char last_v;
+static unsigned long dist;
+
+void
+ini_perf(struct sched *e)
+{
+	// e delivers the speed: its Service 1 entry, or the block that carries it
+	perf_state = PERF_WAIT;
+	perf.speed_t = 0;
+	perf.dist_t = 0;
+	sched_solo = e;
+}
+
+void
+end_perf(void)
+{
+	perf_state = PERF_OFF;
+	sched_solo = 0;
+}
+
+static unsigned long
+cross_perf(unsigned long dt, unsigned long a, unsigned long b, unsigned long x)
+{
+	// Time into a sample gap of dt where a value going from a to b reaches x
+	return last_t + (unsigned long)((unsigned long long)dt * (x - a) / (b - a)) - perf.start;
+}
+
+void
+put_perf(unsigned long t, unsigned char speed)
+{
+	unsigned long dt = t - last_t;
+	unsigned long d;
+	
+	switch (perf_state) {
+	case PERF_WAIT:
+		if (speed == 0) perf_state = PERF_READY;
+		break;
+	case PERF_READY:
+		if (speed == 0) break;
+		// Launch is where the speed passed 1 km/h
+		perf.start = last_t + dt / speed;
+		dist = (unsigned long)(1 + speed) * (t - perf.start);
+		perf_state = PERF_RUN;
+		break;
+	case PERF_RUN:
+		d = dist + (unsigned long)(last_v + speed) * dt;
+		if (!perf.speed_t && speed >= PERF_SPEED) {
+			perf.speed_t = cross_perf(dt, last_v, speed, PERF_SPEED);
+		}
+		if (d >= PERF_DIST) {
+			perf.dist_t = cross_perf(dt, dist, d, PERF_DIST);
+			perf.trap = last_v + (long long)(speed - last_v) * (PERF_DIST - dist) / (d - dist);
+		}
+		dist = d;
+		if (perf.dist_t || speed == 0 || t - perf.start > PERF_LIMIT) {
+			perf_state = PERF_DONE;
+			sched_solo = 0;
+		}
+		break;
+	}
+	last_t = t;
+	last_v = speed;
+}
@@ -0,0 +1,30 @@
+#ifndef __perf__
+#define __perf__
+
+#define PERF_SPEED 100 // Speed timed from standstill, in km/h
+#define PERF_DIST 362102400lu // Quarter mile, in km/h * ticks * 2 (402.336 m * 3.6 * TICK_HZ * 2)
+#define PERF_LIMIT (60 * TICK_HZ) // Runs longer than this are abandoned
+
+enum {
+	PERF_OFF,
+	PERF_WAIT, // Waiting for the vehicle to stop
+	PERF_READY, // Stopped, timing starts when it moves
+	PERF_RUN,
+	PERF_DONE
+};
+
+struct perf {
+	unsigned long start; // Timer1 tick of the launch
+	unsigned long speed_t; // Ticks from launch to PERF_SPEED, 0 if not reached
+	unsigned long dist_t; // Ticks from launch to PERF_DIST, 0 if not reached
+	unsigned char trap; // Speed at PERF_DIST, in km/h
+};
+
+extern unsigned char perf_state;
+extern struct perf perf;
+
+void ini_perf(struct sched *e);
+void end_perf(void);
+void put_perf(unsigned long t, unsigned char speed);
+
+#endif
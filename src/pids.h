@@ -0,0 +1,60 @@
+#ifndef __pids__
+#define __pids__
+
+// Service 1 PIDs polled by the reader, one line each:
+//   X(pid, value id, struct obd_vals field, data bytes, shortest and longest
+//     poll period in ms, filter, fuel estimate that needs it, PID_CALC or
+//     PID_TABLE, scaling)
+// The raw value is A, or A * 256 + B for two data bytes; the scaling is a
+// macro that turns the filtered raw value into the value. main.c expands
+// the list into the schedule with each response length, the filters,
+// decode_pid() and the PID of each value id, so a new PID is one line here and one value id, and a PID
+// left out costs no code at all. The order is the polling order of
+// entries with the same deadline. Between its two periods the schedule
+// polls a PID faster while its value moves and slower while it is steady;
+// RPM, speed and the air flow are polled as often as possible.
+//
+// Not generated: what a new value drives besides the log, telemetry and
+// alarms (trip statistics, resampling, histograms, the fuel estimate),
+// which is the second switch in decode_pid(), and the LCD pages. Each page
+// pairs values from PIDs with derived ones (gear, power, fuel, trip) in
+// 16 characters, so a per-PID field has no place to go; a PID that only
+// needs logging needs neither.
+//
+// PID_TABLE decodes a one byte PID with a 256 entry table in flash,
+// built by the preprocessor from the scaling: one flash read instead of
+// the arithmetic, for 256 bytes of flash. It pays off for scalings that
+// divide, and needs a value that fits in a byte.
+
+#define PID_ANY 0xff // Polled whatever the fuel estimate
+
+#define PID_LIST(X) \
+	X(0x0C, VAL_RPM, rpm, 2, 0, 0, FILT_EMA(2), PID_ANY, PID_CALC, SCALE_RPM) \
+	X(0x0D, VAL_SPEED, speed, 1, 0, 0, FILT_NONE, PID_ANY, PID_CALC, SCALE_RAW) \
+	X(0x04, VAL_LOAD, load, 1, 200, 2000, FILT_EMA(2), PID_ANY, PID_TABLE, SCALE_PERCENT) \
+	X(0x05, VAL_TEMP, temperature, 1, 1000, 20000, FILT_NONE, PID_ANY, PID_CALC, SCALE_TEMP) \
+	X(0x01, VAL_MIL, mil, 4, 5000, 30000, FILT_NONE, PID_ANY, PID_CALC, SCALE_MIL) \
+	X(0x10, VAL_MAF, maf, 2, 0, 0, FILT_MED3, FUEL_MAF, PID_CALC, SCALE_RAW) \
+	X(0x0B, VAL_MAP, map, 1, 0, 0, FILT_MED3, FUEL_SD, PID_CALC, SCALE_RAW) \
+	X(0x0F, VAL_IAT, iat, 1, 1000, 20000, FILT_NONE, FUEL_SD, PID_CALC, SCALE_TEMP)
+
+#define SCALE_RAW(r) (r) // kPa, km/h, g/s * 100
+#define SCALE_RPM(r) ((r) / 4) // ((A * 256) + B) / 4
+#define SCALE_PERCENT(r) ((r) * 100 / 255) // A * 100 / 255
+#define SCALE_TEMP(r) ((r) - 40) // A - 40, in Celsius
+#define SCALE_MIL(r) ((r) >> 7) // MIL is bit 7 of A
+
+// Scaled value of the filtered raw value r
+#define PID_CALC(p, scale, r) scale(r)
+#define PID_TABLE(p, scale, r) pgm_read_byte(&pid_table_##p[(unsigned char)(r)])
+
+// Table definitions, for the PID_TABLE entries only
+#define PID_CALC_DEF(p, scale)
+#define PID_TABLE_DEF(p, scale) static const unsigned char pid_table_##p[256] PROGMEM = { PID_REP256(scale) };
+
+#define PID_REP4(f, i) f(i), f(i + 1), f(i + 2), f(i + 3),
+#define PID_REP16(f, i) PID_REP4(f, i) PID_REP4(f, i + 4) PID_REP4(f, i + 8) PID_REP4(f, i + 12)
+#define PID_REP64(f, i) PID_REP16(f, i) PID_REP16(f, i + 16) PID_REP16(f, i + 32) PID_REP16(f, i + 48)
+#define PID_REP256(f) PID_REP64(f, 0) PID_REP64(f, 64) PID_REP64(f, 128) PID_REP64(f, 192)
+
+#endif
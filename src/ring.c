@@ -0,0 +1,134 @@
+#include <string.h>
+#include "ring.h"
+
+// Each record is varint((dt << 4) | ch) followed by varint(zigzag(dv)),
+// where dt is the time since the previous record and dv the change since
+// the previous record of the same channel. Samples that repeat the last
+// recorded value are not stored; readers hold the previous value instead.
+// When the buffer is full the oldest records are folded into the base
+// state, which is where iteration starts.
+
+static unsigned char ring[RING_SIZE];
+static unsigned short ring_tail;
+static unsigned short ring_used;
+static unsigned long base_t, head_t;
+static unsigned short base_v[RING_CH], head_v[RING_CH];
+static unsigned short ring_seen;
+
+static unsigned char
+get_varint(unsigned short *pos, unsigned long *x)
+{
+	unsigned char b, n = 0, s = 0;
+	*x = 0;
+	do {
+		b = ring[*pos];
+		if (++*pos == RING_SIZE) *pos = 0;
+		*x |= (unsigned long)(b & 0x7f) << s;
+		s += 7;
+		++n;
+	} while (b & 0x80);
+	return n;
+}
+
+static unsigned char
+put_varint(unsigned char *p, unsigned long x)
+{
+	unsigned char n = 0;
+	while (x >= 0x80) {
+		p[n++] = (unsigned char)x | 0x80;
+		x >>= 7;
+	}
+	p[n++] = (unsigned char)x;
+	return n;
+}
+
+static unsigned char
+get_rec(unsigned short *pos, unsigned char *ch, unsigned long *dt, unsigned short *dv)
+{
+	unsigned long x;
+	unsigned char n = get_varint(pos, &x);
+	*ch = x & 0x0f;
+	*dt = x >> 4;
+	n += get_varint(pos, &x);
+	*dv = (unsigned short)(x >> 1) ^ -(unsigned short)(x & 1);
+	return n;
+}
+
+void
+clr_ring(void)
+{
+	ring_tail = ring_used = 0;
+	base_t = head_t = 0;
+	ring_seen = 0;
+	memset(base_v, 0, sizeof(base_v));
+	memset(head_v, 0, sizeof(head_v));
+}
+
+unsigned char
+put_ring(unsigned char ch, unsigned long t, unsigned short v)
+{
+	unsigned char rec[RING_REC], len, c;
+	unsigned short d, head;
+	unsigned long dt;
+	
+	if (ch >= RING_CH) return 0;
+	t >>= RING_TSHIFT;
+	if (ring_used == 0) {
+		base_t = head_t = t;
+		memcpy(base_v, head_v, sizeof(base_v));
+	}
+	if ((ring_seen & (1u << ch)) && head_v[ch] == v) return 0;
+	
+	d = v - head_v[ch];
+	len = put_varint(rec, ((t - head_t) << 4) | ch);
+	len += put_varint(rec + len, (unsigned short)((d << 1) ^ -(d >> 15)));
+	
+	// Drop the oldest records until the new one fits
+	while (RING_SIZE - ring_used < len) {
+		ring_used -= get_rec(&ring_tail, &c, &dt, &d);
+		base_t += dt;
+		base_v[c] += d;
+	}
+	
+	head = ring_tail + ring_used;
+	if (head >= RING_SIZE) head -= RING_SIZE;
+	for (c = 0; c < len; ++c) {
+		ring[head] = rec[c];
+		if (++head == RING_SIZE) head = 0;
+	}
+	ring_used += len;
+	head_t = t;
+	head_v[ch] = v;
+	ring_seen |= 1u << ch;
+	return 1;
+}
+
+unsigned short
+free_ring(void)
+{
+	return RING_SIZE - ring_used;
+}
+
+void
+first_ring(struct ring_it *it)
+{
+	it->pos = ring_tail;
+	it->n = ring_used;
+	it->t = base_t;
+	memcpy(it->v, base_v, sizeof(it->v));
+}
+
+unsigned char
+next_ring(struct ring_it *it, unsigned char *ch, unsigned long *t, unsigned short *v)
+{
+	unsigned long dt;
+	unsigned short d;
+	
+	if (it->n == 0) return 0;
+	it->n -= get_rec(&it->pos, ch, &dt, &d);
+	it->t += dt;
+	it->v[*ch] += d;
+	*t = it->t << RING_TSHIFT;
+	*v = it->v[*ch];
+	return 1;
+}
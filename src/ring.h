@@ -0,0 +1,22 @@
+#ifndef __ring__
+#define __ring__
+
+#define RING_SIZE 384 // Bytes of SRAM reserved for sample history
+#define RING_CH 16 // Channels (value ids) that can be recorded
+#define RING_TSHIFT 7 // Timestamps are kept in units of 128 ticks (1.024 ms)
+#define RING_REC 8 // Longest record, in bytes
+
+struct ring_it {
+	unsigned short pos;
+	unsigned short n;
+	unsigned long t;
+	unsigned short v[RING_CH];
+};
+
+void clr_ring(void);
+unsigned char put_ring(unsigned char ch, unsigned long t, unsigned short v);
+unsigned short free_ring(void);
+void first_ring(struct ring_it *it);
+unsigned char next_ring(struct ring_it *it, unsigned char *ch, unsigned long *t, unsigned short *v);
+
+#endif
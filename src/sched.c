@@ -0,0 +1,77 @@
+#include "avr.h"
+#include "sched.h"
+
+// Earliest deadline first: the entry due first is polled next and becomes
+// due again one period later. Entries with period 0 are always due, so
+// they share whatever bus time is left in round-robin order. While
+// sched_solo is set only that entry is polled, and the other entries keep
+// their deadlines.
+//
+// Entries with a range of periods adapt to their value: a response that
+// moved by more than the noise halves the period, a steady one lengthens
+// it by an eighth. A value that starts moving is back at the shortest
+// period within a few polls, and bus time goes to the values that change.
+
+struct sched sched[SCHED_MAX];
+unsigned char nsched;
+struct sched *sched_solo;
+
+unsigned char
+add_sched(unsigned char service, unsigned char pid, unsigned char len, unsigned short min, unsigned short max)
+{
+	unsigned char i;
+	for (i = 0; i < nsched && (sched[i].service != service || sched[i].pid != pid); ++i);
+	if (i == nsched) {
+		if (nsched == SCHED_MAX) return 0;
+		++nsched;
+		sched[i].service = service;
+		sched[i].pid = pid;
+		sched[i].due = 0;
+	}
+	sched[i].len = len;
+	sched[i].period = min;
+	sched[i].min = min;
+	sched[i].max = max;
+	return 1;
+}
+
+struct sched *
+find_sched(unsigned char service, unsigned char pid)
+{
+	struct sched *e;
+	for (e = sched; e < sched + nsched; ++e) {
+		if (e->service == service && e->pid == pid) return e;
+	}
+	return 0;
+}
+
+struct sched *
+next_sched(unsigned long t)
+{
+	struct sched *e, *best = 0;
+	for (e = sched; e < sched + nsched; ++e) {
+		if (sched_solo && e != sched_solo) continue;
+		if (!best || (long)(e->due - best->due) < 0) best = e;
+	}
+	if (best) best->due = t + best->period * (TICK_HZ / 1000);
+	return best;
+}
+
+void
+put_sched(struct sched *e, const unsigned char *d)
+{
+	// d is the data of a valid response to e
+	unsigned short v = e->len > 1 ? d[0] << 8 | d[1] : d[0];
+	unsigned short c = v > e->last ? v - e->last : e->last - v;
+	unsigned short p = e->period;
+	
+	e->last = v;
+	if (e->min == e->max) return;
+	if (c > SCHED_NOISE) {
+		e->period = p / 2 < e->min ? e->min : p / 2;
+		e->due -= (unsigned long)(p - e->period) * (TICK_HZ / 1000); // Poll sooner this time already
+	}
+	else {
+		e->period = p + p / 8 + 1 > e->max ? e->max : p + p / 8 + 1;
+	}
+}
@@ -0,0 +1,26 @@
+#ifndef __sched__
+#define __sched__
+
+#define SCHED_MAX 12
+#define SCHED_NOISE 1 // Raw change between polls that still counts as steady
+
+struct sched {
+	unsigned char service; // 0x01, or 0x21 for a local identifier block
+	unsigned char pid; // PID or local identifier
+	unsigned char len; // Data bytes in the response, the fewest used for a block
+	unsigned short period; // Shortest time between polls, in ms; 0 polls as often as possible
+	unsigned short min, max; // Bounds of the period, equal for a fixed one
+	unsigned short last; // Raw value of the last response
+	unsigned long due; // Timer1 tick of the next poll
+};
+
+extern struct sched sched[SCHED_MAX];
+extern unsigned char nsched;
+extern struct sched *sched_solo; // Entry given the whole bus, 0 for none
+
+unsigned char add_sched(unsigned char service, unsigned char pid, unsigned char len, unsigned short min, unsigned short max);
+struct sched *find_sched(unsigned char service, unsigned char pid);
+struct sched *next_sched(unsigned long t);
+void put_sched(struct sched *e, const unsigned char *d);
+
+#endif
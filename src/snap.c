@@ -0,0 +1,34 @@
+#include <string.h>
+#include "avr.h"
+#include "snap.h"
+
+// Double-buffered snapshot of the decoded values. The writer (bus engine,
+// possibly in an ISR) fills the buffer that is not published, then flips
+// snap_idx and bumps snap_seq. The reader copies the published buffer and
+// retries if a flip happened meanwhile, so neither side disables interrupts.
+
+static struct obd_vals snap_buf[2];
+static volatile unsigned char snap_idx;
+static volatile unsigned char snap_seq;
+
+void
+put_snap(const struct obd_vals *v)
+{
+	unsigned char i = snap_idx ^ 1;
+	memcpy(&snap_buf[i], v, sizeof(struct obd_vals));
+	BARRIER();
+	snap_idx = i;
+	++snap_seq;
+}
+
+void
+get_snap(struct obd_vals *v)
+{
+	unsigned char s;
+	do {
+		s = snap_seq;
+		BARRIER();
+		memcpy(v, &snap_buf[snap_idx], sizeof(struct obd_vals));
+		BARRIER();
+	} while (s != snap_seq);
+}
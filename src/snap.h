@@ -0,0 +1,48 @@
+#ifndef __snap__
+#define __snap__
+
+// Value ids, shared by the history buffer and the other value consumers
+enum {
+	VAL_LOAD,
+	VAL_TEMP,
+	VAL_RPM,
+	VAL_SPEED,
+	VAL_MAP,
+	VAL_IAT,
+	VAL_MAF,
+	VAL_FUEL,
+	VAL_MIL,
+	VAL_BATT,
+	VAL_CRANK,
+	VAL_OIL,
+	VAL_EGT,
+	VAL_BOOST,
+	VAL_GEAR,
+	VAL_POWER,
+	NUM_VALS
+};
+
+struct obd_vals {
+	unsigned char load; // Engine load
+	signed char temperature; // Engine coolant temperature
+	unsigned short rpm; // Instantaneous engine RPM
+	unsigned char speed; // Instantaneous vehicle speed
+	unsigned char map; // Intake manifold absolute pressure, in kPa
+	signed char iat; // Intake air temperature
+	unsigned short maf; // Mass air flow, in g/s * 100
+	unsigned short fuel; // Fuel rate, in cL/h
+	unsigned char mil; // Malfunction indicator lamp on
+	unsigned char dtcs; // Number of stored trouble codes
+	unsigned short batt; // Battery voltage, in mV
+	unsigned short crank; // Lowest battery voltage during the last engine start, in mV
+	unsigned short oil; // Oil pressure, in kPa
+	unsigned short egt; // Exhaust gas temperature, in Celsius
+	unsigned short boost; // Boost pressure, absolute in kPa
+	unsigned char gear; // Estimated gear, 0 if unknown
+	unsigned short power; // Estimated engine power from the air flow, in kW
+};
+
+void put_snap(const struct obd_vals *v);
+void get_snap(struct obd_vals *v);
+
+#endif
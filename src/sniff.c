@@ -0,0 +1,79 @@
+#include "avr.h"
+#include "sniff.h"
+
+// Messages on the K-line are only delimited by timing: bytes of one
+// message follow each other within P1max (ECU) or P4max (tester), and the
+// next message comes at least P2min later. A message is complete once the
+// line has been quiet for SNIFF_GAP. The header tells requests from
+// responses:
+//   68 6A F1 ...   ISO 9141-2 request from the tester
+//   48 6B xx ...   ISO 9141-2 response
+//   Cx yy F1 ...   KWP2000 request (format, target, source F1)
+//   8x F1 yy ...   KWP2000 response (target F1)
+
+unsigned char sniff_req[SNIFF_MAX];
+unsigned char sniff_rsp[SNIFF_MAX];
+unsigned char sniff_rlen;
+unsigned short sniff_msgs;
+unsigned short sniff_pairs;
+static unsigned char sniff_buf[SNIFF_MAX];
+static unsigned char sniff_len;
+static unsigned char sniff_over; // Message was longer than SNIFF_MAX, or lost a byte
+static unsigned char sniff_qlen; // Length of sniff_req, 0 if none
+static unsigned long sniff_t; // Time of the last byte
+
+void
+put_sniff(unsigned char c, unsigned long t)
+{
+	if (sniff_len < SNIFF_MAX) sniff_buf[sniff_len++] = c;
+	else sniff_over = 1;
+	sniff_t = t;
+}
+
+void
+drop_sniff(void)
+{
+	// The USART overran: a byte is missing, so the message is discarded
+	// when it completes
+	sniff_over = 1;
+}
+
+unsigned char
+run_sniff(unsigned long t)
+{
+	// 1 when a response to the last request has just completed
+	unsigned char i, sum = 0, n = sniff_len;
+	unsigned char *m = sniff_buf;
+	
+	if (!n || t - sniff_t <= SNIFF_GAP) return 0;
+	sniff_len = 0;
+	if (sniff_over || n < 5) {
+		sniff_over = 0;
+		return 0;
+	}
+	for (i = 0; i < n - 1; ++i) {
+		sum += m[i];
+	}
+	if (sum != m[n - 1]) return 0;
+	++sniff_msgs;
+	
+	if (m[2] == 0xF1 && (m[0] == 0x68 || (m[0] & 0xC0) == 0xC0)) { // Request
+		for (i = 0; i < n; ++i) {
+			sniff_req[i] = m[i];
+		}
+		sniff_qlen = n;
+		return 0;
+	}
+	if ((m[0] == 0x48 && m[1] == 0x6B) || ((m[0] & 0xC0) == 0x80 && m[1] == 0xF1)) { // Response
+		// Positive response to the last request: service + 0x40, and the same PID
+		if (!sniff_qlen || m[3] != sniff_req[3] + 0x40) return 0;
+		if (sniff_qlen > 5 && n > 5 && m[4] != sniff_req[4]) return 0;
+		for (i = 0; i < n; ++i) {
+			sniff_rsp[i] = m[i];
+		}
+		sniff_rlen = n;
+		++sniff_pairs;
+		return 1;
+	}
+	return 0;
+}
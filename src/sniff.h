@@ -0,0 +1,20 @@
+#ifndef __sniff__
+#define __sniff__
+
+#define SNIFF_MAX 16 // Longest message kept
+#define SNIFF_GAP (23 * TICK_HZ / 1000) // Between P1/P4max (20 ms) and P2min (25 ms): a longer gap ends a message
+#define SNIFF_LISTEN 2000 // Time spent listening for another tester at power-up, in ms
+
+// Last request and the response paired with it. Both keep the 3-byte
+// header and the checksum.
+extern unsigned char sniff_req[SNIFF_MAX];
+extern unsigned char sniff_rsp[SNIFF_MAX];
+extern unsigned char sniff_rlen;
+extern unsigned short sniff_msgs; // Valid messages seen
+extern unsigned short sniff_pairs; // Responses paired with a request
+
+void put_sniff(unsigned char c, unsigned long t);
+void drop_sniff(void);
+unsigned char run_sniff(unsigned long t);
+
+#endif
@@ -0,0 +1,20 @@
+#include "avr.h"
+#include "spi.h"
+
+void
+ini_spi(void)
+{
+	SET_BIT(PORTB, SPI_SS);
+	DDRB |= (1 << SPI_SS) | (1 << 5) | (1 << 7); // SS, MOSI and SCK are outputs
+	CLR_BIT(DDRB, 6); // MISO is an input
+	SPCR = (1 << SPE) | (1 << MSTR);
+	SPSR = (1 << SPI2X); // fosc / 2 = 4 MHz
+}
+
+unsigned char
+xfer_spi(unsigned char d)
+{
+	SPDR = d;
+	while (!GET_BIT(SPSR, SPIF));
+	return SPDR;
+}
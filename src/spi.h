@@ -0,0 +1,9 @@
+#ifndef __spi__
+#define __spi__
+
+#define SPI_SS 4 // PB4, chip select of the storage device
+
+void ini_spi(void);
+unsigned char xfer_spi(unsigned char d);
+
+#endif
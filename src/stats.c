@@ -0,0 +1,88 @@
+#include <string.h>
+#include "avr.h"
+#include "eep.h"
+#include "stats.h"
+
+// put_stats() only adds and compares; the divisions needed to turn the
+// sums into distances and averages happen when a value is read.
+
+struct trip trip;
+struct trip_max trip_max;
+static unsigned long last_t;
+static unsigned long save_t;
+static unsigned char running;
+
+static void
+save_stats(void)
+{
+	put_eep(EEP_TRIP, &trip, sizeof(trip));
+	put_eep(EEP_MAXV, &trip_max, sizeof(trip_max));
+	save_t = trip.on_t;
+}
+
+void
+ini_stats(void)
+{
+	get_eep(EEP_TRIP, &trip, sizeof(trip));
+	get_eep(EEP_MAXV, &trip_max, sizeof(trip_max));
+	save_t = trip.on_t;
+}
+
+void
+clr_stats(void)
+{
+	memset(&trip, 0, sizeof(trip));
+	memset(&trip_max, 0, sizeof(trip_max));
+	save_stats();
+}
+
+void
+put_stats(unsigned long t, unsigned char speed, unsigned short rpm)
+{
+	unsigned long dt = t - last_t;
+	
+	if (!last_t || dt > STATS_GAP) dt = 0;
+	last_t = t;
+	dt >>= 7;
+	
+	if (speed > trip_max.max_speed) trip_max.max_speed = speed;
+	if (rpm > trip_max.max_rpm) trip_max.max_rpm = rpm;
+	trip.speed_sum += (unsigned long)speed * dt;
+	trip.rpm_sum += (unsigned long)rpm * dt;
+	if (speed) trip.move_t += dt;
+	if (rpm) {
+		trip.on_t += dt;
+		if (!speed) trip_max.idle_t += dt;
+	}
+	if (rpm >= STATS_RPM_HI) trip_max.rpm_hi_t += dt;
+	if (speed >= STATS_SPEED_HI) trip_max.speed_hi_t += dt;
+	
+	// The trip is saved when the engine stops, and now and then while it runs
+	if (rpm) {
+		running = 1;
+		if (trip.on_t - save_t >= STATS_SAVE) save_stats();
+	}
+	else if (running) {
+		running = 0;
+		save_stats();
+	}
+}
+
+unsigned long
+dist_stats(void)
+{
+	// km/h * 128 ticks to meters: * 128 / (3.6 * TICK_HZ)
+	return trip.speed_sum * 8 / 28125;
+}
+
+unsigned char
+avg_speed_stats(void)
+{
+	return trip.move_t ? trip.speed_sum / trip.move_t : 0;
+}
+
+unsigned short
+avg_rpm_stats(void)
+{
+	return trip.on_t ? trip.rpm_sum / trip.on_t : 0;
+}
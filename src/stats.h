@@ -0,0 +1,36 @@
+#ifndef __stats__
+#define __stats__
+
+#define STATS_RPM_HI 4000 // RPM counted as high
+#define STATS_SPEED_HI 120 // Speed counted as high, in km/h
+#define STATS_SAVE (600 * TICK_HZ >> 7) // Save every 10 minutes of engine time
+#define STATS_GAP (2 * TICK_HZ) // Longest gap between samples that is integrated
+
+// Times are in units of 128 Timer1 ticks (1.024 ms). Each struct is one
+// EEPROM record.
+struct trip {
+	unsigned long long speed_sum; // Sum of speed * time, km/h units
+	unsigned long long rpm_sum; // Sum of rpm * time
+	unsigned long on_t; // Engine running
+	unsigned long move_t; // Vehicle moving
+};
+
+struct trip_max {
+	unsigned long idle_t; // Engine running, vehicle stopped
+	unsigned long rpm_hi_t; // RPM at or above STATS_RPM_HI
+	unsigned long speed_hi_t; // Speed at or above STATS_SPEED_HI
+	unsigned short max_rpm;
+	unsigned char max_speed;
+};
+
+extern struct trip trip;
+extern struct trip_max trip_max;
+
+void ini_stats(void);
+void clr_stats(void);
+void put_stats(unsigned long t, unsigned char speed, unsigned short rpm);
+unsigned long dist_stats(void);
+unsigned char avg_speed_stats(void);
+unsigned short avg_rpm_stats(void);
+
+#endif
@@ -0,0 +1,105 @@
+#include "avr.h"
+#include "suart.h"
+
+// Timer2 interrupts at three times the bit rate; every third interrupt
+// shifts out one bit of the byte at the tail of the transmit buffer. The
+// receiver samples PD2 on every interrupt while idle; once it sees a start
+// bit it samples each following bit three interrupts apart, starting four
+// interrupts after the edge, i.e. near the middle of data bit 0.
+
+#define TX_PIN 3
+#define RX_PIN 2
+
+static volatile unsigned char tx_buf[SUART_TXBUF];
+static volatile unsigned char tx_head, tx_tail;
+static unsigned short tx_shift;
+static unsigned char tx_bits, tx_phase;
+static volatile unsigned char rx_buf[SUART_RXBUF];
+static volatile unsigned char rx_head, rx_tail;
+static unsigned char rx_shift, rx_bits, rx_wait;
+
+void
+ini_suart(void)
+{
+	SET_BIT(PORTB, TX_PIN); // Idle high
+	SET_BIT(DDRB, TX_PIN);
+	CLR_BIT(DDRD, RX_PIN);
+	SET_BIT(PORTD, RX_PIN); // Pull-up keeps an unconnected line idle
+	TCCR2 = (1 << WGM21) | (1 << CS21); // CTC, prescaler 8
+	OCR2 = (XTAL_FRQ / 8 + SUART_BAUD * 3 / 2) / (SUART_BAUD * 3) - 1;
+	SET_BIT(TIMSK, OCIE2);
+}
+
+unsigned char
+write_suart(const unsigned char *p, unsigned char n)
+{
+	unsigned char h = tx_head, t = tx_tail;
+	unsigned char used = h >= t ? h - t : h + SUART_TXBUF - t;
+	if (n > SUART_TXBUF - 1 - used) return 0;
+	while (n--) {
+		tx_buf[h] = *p++;
+		if (++h == SUART_TXBUF) h = 0;
+	}
+	tx_head = h;
+	return 1;
+}
+
+void
+puts_suart(const char *s)
+{
+	while (*s) {
+		while (!write_suart((const unsigned char *)s, 1));
+		++s;
+	}
+}
+
+unsigned char
+get_suart(unsigned char *c)
+{
+	unsigned char t = rx_tail;
+	if (t == rx_head) return 0;
+	*c = rx_buf[t];
+	if (++t == SUART_RXBUF) t = 0;
+	rx_tail = t;
+	return 1;
+}
+
+ISR(TIMER2_COMP_vect)
+{
+	unsigned char h;
+	
+	if (rx_wait) {
+		if (--rx_wait == 0) {
+			if (rx_bits < 8) { // Data bit, LSB first
+				rx_shift >>= 1;
+				if (GET_BIT(PIND, RX_PIN)) rx_shift |= 0x80;
+				++rx_bits;
+				rx_wait = 3;
+			}
+			else if (GET_BIT(PIND, RX_PIN)) { // Valid stop bit
+				h = rx_head + 1;
+				if (h == SUART_RXBUF) h = 0;
+				if (h != rx_tail) {
+					rx_buf[rx_head] = rx_shift;
+					rx_head = h;
+				}
+			}
+		}
+	}
+	else if (!GET_BIT(PIND, RX_PIN)) { // Start bit
+		rx_bits = 0;
+		rx_wait = 4;
+	}
+	
+	if (++tx_phase < 3) return;
+	tx_phase = 0;
+	if (!tx_bits) {
+		if (tx_head == tx_tail) return;
+		tx_shift = (tx_buf[tx_tail] << 1) | 0x200; // Start bit, data, stop bit
+		if (++tx_tail == SUART_TXBUF) tx_tail = 0;
+		tx_bits = 10;
+	}
+	if (tx_shift & 1) SET_BIT(PORTB, TX_PIN); else CLR_BIT(PORTB, TX_PIN);
+	tx_shift >>= 1;
+	--tx_bits;
+}
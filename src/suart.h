@@ -0,0 +1,16 @@
+#ifndef __suart__
+#define __suart__
+
+// Software UART for the host link, 9600 baud 8N1 on PB3 (TX) and PD2 (RX).
+// The hardware USART is dedicated to the K-line.
+
+#define SUART_BAUD 9600
+#define SUART_TXBUF 128 // Two of the longest telemetry frames (52 bytes); indices stay in a byte
+#define SUART_RXBUF 16
+
+void ini_suart(void);
+unsigned char write_suart(const unsigned char *p, unsigned char n);
+void puts_suart(const char *s);
+unsigned char get_suart(unsigned char *c);
+
+#endif
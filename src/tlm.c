@@ -0,0 +1,99 @@
+#include "crc.h"
+#include "suart.h"
+#include "tlm.h"
+
+#define TLM_BASE 4 // Base time at the start of a TLM_SAMPLES payload
+
+static unsigned char tlm_buf[TLM_BASE + TLM_MAXREC * TLM_REC];
+static unsigned char tlm_len;
+static unsigned long tlm_t;
+static unsigned short tlm_seq;
+unsigned short tlm_drop; // Frames lost because the link was busy
+unsigned char tlm_wait;
+
+static unsigned char
+send_frame(unsigned char type, const unsigned char *p, unsigned char n)
+{
+	unsigned char out[TLM_BASE + TLM_MAXREC * TLM_REC + 8];
+	unsigned char code = 0, len = 1, i, b;
+	unsigned short crc = 0xffff;
+	
+	// COBS: each code byte gives the distance to the next zero
+	for (i = 0; i < n + 5; ++i) {
+		if (i == 0) b = type;
+		else if (i == 1) b = tlm_seq;
+		else if (i == 2) b = tlm_seq >> 8;
+		else if (i < n + 3) b = p[i - 3];
+		else b = i == n + 3 ? crc >> 8 : crc;
+		if (i < n + 3) crc = crc16(crc, b);
+		if (b) {
+			out[len++] = b;
+		}
+		if (!b || len - code == 0xff) {
+			out[code] = len - code;
+			code = len++;
+		}
+	}
+	out[code] = len - code;
+	out[len++] = 0;
+	++tlm_seq; // Counted even when dropped, so the host sees the gap
+	while (!write_suart(out, len)) {
+		if (!tlm_wait) {
+			++tlm_drop;
+			return 0;
+		}
+	}
+	return 1;
+}
+
+void
+put_tlm(unsigned char id, unsigned long t, unsigned short v)
+{
+	unsigned char *r;
+	t >>= TLM_TSHIFT;
+	if (tlm_len && (tlm_len == TLM_MAXREC || t - tlm_t > 0xffff)) flush_tlm();
+	if (!tlm_len) {
+		tlm_t = t;
+		tlm_buf[0] = t;
+		tlm_buf[1] = t >> 8;
+		tlm_buf[2] = t >> 16;
+		tlm_buf[3] = t >> 24;
+	}
+	t -= tlm_t;
+	r = tlm_buf + TLM_BASE + tlm_len * TLM_REC;
+	r[0] = id;
+	r[1] = t;
+	r[2] = t >> 8;
+	r[3] = v;
+	r[4] = v >> 8;
+	++tlm_len;
+}
+
+void
+map_tlm(const unsigned char *pids, unsigned char n)
+{
+	send_frame(TLM_MAP, pids, n);
+}
+
+void
+flush_tlm(void)
+{
+	if (!tlm_len) return;
+	send_frame(TLM_SAMPLES, tlm_buf, TLM_BASE + tlm_len * TLM_REC);
+	tlm_len = 0;
+}
+
+unsigned char
+hist_tlm(unsigned char which, unsigned char row, const unsigned short *n, unsigned char len)
+{
+	unsigned char p[2 + 2 * 16];
+	unsigned char i;
+	if (len > 16) len = 16;
+	p[0] = which;
+	p[1] = row;
+	for (i = 0; i < len; ++i) {
+		p[2 + 2 * i] = n[i];
+		p[3 + 2 * i] = n[i] >> 8;
+	}
+	return send_frame(TLM_HIST, p, 2 + 2 * len);
+}
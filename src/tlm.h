@@ -0,0 +1,29 @@
+#ifndef __tlm__
+#define __tlm__
+
+// Telemetry frames sent to the host, COBS encoded and terminated by 0x00.
+// Decoded frame: type, sequence number, payload, CRC-16 (CCITT, big
+// endian) of everything before it.
+//   TLM_SAMPLES payload: base time (4 bytes), then 5-byte records:
+//     value id, time after the base (2 bytes), value (2 bytes)
+//   TLM_MAP payload: the PID of each value id
+//   TLM_HIST payload: histogram (0 trip, 1 lifetime), first RPM bin,
+//     then 2-byte counters for each load bin of each RPM bin from there
+// Times are Timer1 ticks >> TLM_TSHIFT; multi-byte fields are little
+// endian.
+
+#define TLM_SAMPLES 1
+#define TLM_MAP 2
+#define TLM_HIST 3
+#define TLM_REC 5
+#define TLM_MAXREC 8 // Records per frame
+#define TLM_TSHIFT 7
+
+extern unsigned char tlm_wait; // Wait for room on the link instead of dropping frames
+
+void put_tlm(unsigned char id, unsigned long t, unsigned short v);
+void map_tlm(const unsigned char *pids, unsigned char n);
+void flush_tlm(void);
+unsigned char hist_tlm(unsigned char which, unsigned char row, const unsigned short *n, unsigned char len);
+
+#endif